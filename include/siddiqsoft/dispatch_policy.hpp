@@ -0,0 +1,192 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef DISPATCH_POLICY_HPP
+#define DISPATCH_POLICY_HPP
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+
+namespace siddiqsoft
+{
+    /// @brief A dispatch policy selects the worker for the next item in roundrobin_pool.
+    /// The policy is invoked as `policy.select(sequence, n, load)` where `sequence` is the running count of the items dispatched,
+    /// `n` is the number of active workers (at least 1) and `load(i)` returns the approximate load (deque depth plus the callback
+    /// in progress) on worker `i`. It must return an index in [0, n).
+    /// @remarks The policy is a template parameter of the pool so the selection is inlined into queue(). The policy object is
+    /// shared by all of the producers and must be safe to invoke concurrently.
+    /// A policy which ignores `sequence` should declare `static constexpr bool uses_sequence {false};` so the pool skips the
+    /// shared sequence counter (a cache line contended by every producer) and passes zero instead.
+    template <typename P>
+    concept dispatch_policy = std::default_initializable<P> && requires(P& p, uint64_t sequence, size_t n) {
+        { p.select(sequence, n, [](size_t) -> uint64_t { return 0; }) } -> std::convertible_to<size_t>;
+    };
+
+
+    /// @brief True unless the policy declares that it ignores the sequence
+    template <typename P>
+    inline constexpr bool dispatch_uses_sequence = [] {
+        if constexpr (requires { P::uses_sequence; })
+            return static_cast<bool>(P::uses_sequence);
+        else
+            return true;
+    }();
+
+
+    namespace detail
+    {
+        /// @brief Per-thread xorshift generator; no shared state between the producers
+        inline uint64_t thread_random() noexcept
+        {
+            thread_local uint64_t state = std::hash<std::thread::id> {}(std::this_thread::get_id()) | 1;
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    } // namespace detail
+
+
+    /// @brief Plain modulo of the running counter. The default.
+    struct roundrobin_dispatch
+    {
+        static constexpr const char* name {"roundrobin"};
+
+        template <typename LoadFn>
+        size_t select(uint64_t sequence, size_t n, LoadFn&&) const noexcept
+        {
+            return static_cast<size_t>(sequence % n);
+        }
+    };
+
+
+    /// @brief Round robin using a per-producer cursor (starting at a random worker) instead of the pool's shared counter. Each
+    /// producer spreads its items evenly across the workers and the producers never touch a common cache line; the global
+    /// rotation is only approximate with many producers.
+    struct thread_cursor_dispatch
+    {
+        static constexpr const char* name {"thread_cursor"};
+        static constexpr bool        uses_sequence {false};
+
+        template <typename LoadFn>
+        size_t select(uint64_t, size_t n, LoadFn&&) const noexcept
+        {
+            thread_local uint64_t cursor = detail::thread_random();
+            return static_cast<size_t>(cursor++ % n);
+        }
+    };
+
+
+    /// @brief Uniform random worker
+    struct random_dispatch
+    {
+        static constexpr const char* name {"random"};
+        static constexpr bool        uses_sequence {false};
+
+        template <typename LoadFn>
+        size_t select(uint64_t, size_t n, LoadFn&&) const noexcept
+        {
+            return static_cast<size_t>(detail::thread_random() % n);
+        }
+    };
+
+
+    /// @brief Scans every worker and picks the one with the lowest load. Best balance; the cost grows with the number of workers.
+    struct least_loaded_dispatch
+    {
+        static constexpr const char* name {"least_loaded"};
+
+        template <typename LoadFn>
+        size_t select(uint64_t sequence, size_t n, LoadFn&& load) const
+        {
+            // Start the scan at a rotating offset so ties do not always favour the first worker
+            size_t   best     = static_cast<size_t>(sequence % n);
+            uint64_t bestLoad = load(best);
+            for (size_t i = 1; (i < n) && (bestLoad > 0); i++) {
+                const size_t candidate = (best + i) % n;
+                if (const auto l = load(candidate); l < bestLoad) {
+                    best     = candidate;
+                    bestLoad = l;
+                }
+            }
+            return best;
+        }
+    };
+
+
+    /// @brief Sample two distinct random workers and pick the one with the lower load (power of two choices). Routes around a
+    /// blocked worker at the cost of two loads.
+    struct power_of_two_dispatch
+    {
+        static constexpr const char* name {"power_of_two"};
+        static constexpr bool        uses_sequence {false};
+
+        template <typename LoadFn>
+        size_t select(uint64_t, size_t n, LoadFn&& load) const
+        {
+            if (n <= 1) return 0;
+
+            // Ties go to the first sample
+            const auto r = detail::thread_random();
+            const auto a = static_cast<size_t>(r % n);
+            auto       b = static_cast<size_t>((r >> 32) % (n - 1));
+            if (b >= a) b++;
+            return load(b) < load(a) ? b : a;
+        }
+    };
+
+
+    /// @brief Each producer thread is bound to one worker (assigned on the thread's first use). Items from one producer are
+    /// processed in order and there is no shared counter on the producer path.
+    struct sticky_dispatch
+    {
+        static constexpr const char* name {"sticky"};
+        static constexpr bool        uses_sequence {false};
+
+        template <typename LoadFn>
+        size_t select(uint64_t, size_t n, LoadFn&&) const noexcept
+        {
+            static std::atomic_size_t nextProducer {0};
+            thread_local const size_t producer = nextProducer.fetch_add(1, std::memory_order_relaxed);
+            return producer % n;
+        }
+    };
+} // namespace siddiqsoft
+#endif // !DISPATCH_POLICY_HPP
@@ -0,0 +1,299 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef FAIR_POOL_HPP
+#define FAIR_POOL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <shared_mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "queue_stats.hpp"
+
+
+namespace siddiqsoft
+{
+    /// @brief Implements a fair-queueing thread pool. Items are queued into per-tenant sub-queues and the threads pick the next
+    /// item using deficit round robin (DRR) across the tenants with backlog. A tenant with weight w receives up to w items per
+    /// round so a single noisy tenant cannot starve the others.
+    /// @tparam T Your datatype
+    /// @tparam N Number of threads in the pool. Leave it to 0 to use the value returned by std::thread::hardware_concurrency()
+    /// @tparam K The tenant identifier; must be hashable
+    /// @remarks Each item costs one unit. Tenants are created on first use and retained (along with their weight and counters)
+    /// for the lifetime of the pool.
+    template <typename T, uint16_t N = 0, typename K = std::string>
+        requires std::is_move_constructible_v<T>
+    struct fair_pool
+    {
+        fair_pool(fair_pool&&)            = delete;
+        fair_pool& operator=(fair_pool&&) = delete;
+        fair_pool(fair_pool&)             = delete;
+        fair_pool& operator=(fair_pool&)  = delete;
+
+
+        /// @brief Destructor.
+        /// @remarks Reduce the signal wait interval and wake the threads so they may be stopped. Queued items are abandoned.
+        ~fair_pool()
+        {
+            signalWaitInterval = std::chrono::milliseconds(0);
+            for (auto& t : workers) {
+                signal.release();
+                if (t.request_stop() && t.joinable()) t.join();
+            }
+        }
+
+
+        /// @brief Contructs a threadpool with N threads with the given callback/worker function
+        /// @param c The worker function.
+        fair_pool(std::function<void(T&&)> c)
+            : callback(std::move(c))
+        {
+            workers.reserve((N > 0) ? N : std::thread::hardware_concurrency());
+
+            for (unsigned i = 0; i < ((N > 0) ? N : std::thread::hardware_concurrency()); i++) {
+                workers.emplace_back([this](std::stop_token st) {
+                    while (!st.stop_requested()) {
+                        try {
+                            if (auto entry = getNextItem(); entry.has_value() && !st.stop_requested()) {
+                                invoke(std::move(*entry));
+                            }
+                        }
+                        catch (...) {
+                        }
+                    } // while ..continue until we're asked to stop
+                });
+            }
+        }
+
+        /// @brief Queue item into the tenant's sub-queue (takes "ownership" of the item)
+        /// @param tenant The tenant (producer) identifier
+        /// @param item Item to queue must be move'd
+        void queue(const K& tenant, T&& item)
+        {
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                auto& tq = tenants[tenant];
+                tq.items.emplace_back(std::move(item));
+                tq.queueCounter++;
+                tq.gauges.pushed();
+                // A tenant which just received backlog joins the end of the round
+                if (!tq.active) {
+                    tq.active  = true;
+                    tq.deficit = 0;
+                    active.push_back(&tq);
+                }
+            }
+            signal.release();
+            ++queueCounter;
+        }
+
+        /// @brief Sets the share for the tenant; a tenant with weight 2 receives twice as many items per round as a tenant with
+        /// weight 1
+        /// @param tenant The tenant (producer) identifier
+        /// @param weight The number of items per round; minimum 1
+        void set_weight(const K& tenant, uint32_t weight)
+        {
+            std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+            tenants[tenant].weight = std::max<uint32_t>(1, weight);
+        }
+
+        /// @brief Snapshot of the gauges and counters for the tenant
+        /// @param tenant The tenant (producer) identifier
+        /// @return Empty stats if the tenant is unknown
+        queue_stats stats(const K& tenant) const
+        {
+            std::shared_lock<std::shared_mutex> myReaderLock(items_mutex);
+
+            if (auto it = tenants.find(tenant); it != tenants.end()) return it->second.snapshot();
+            return {};
+        }
+
+        /// @brief Snapshot of the gauges and counters for every known tenant
+        std::vector<std::pair<K, queue_stats>> stats() const
+        {
+            std::shared_lock<std::shared_mutex>    myReaderLock(items_mutex);
+            std::vector<std::pair<K, queue_stats>> result {};
+
+            result.reserve(tenants.size());
+            for (const auto& [tenant, tq] : tenants) {
+                result.emplace_back(tenant, tq.snapshot());
+            }
+            return result;
+        }
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            std::shared_lock<std::shared_mutex> myReaderLock(items_mutex);
+
+            return nlohmann::json {{"_typver", "siddiqsoft.asynchrony-lib.fair_pool/0.10"},
+                                   {"workersSize", workers.size()},
+                                   {"tenantsSize", tenants.size()},
+                                   {"activeTenants", active.size()},
+                                   {"queueCounter", queueCounter.load()},
+                                   {"waitInterval", signalWaitInterval.count()}};
+        }
+#endif
+
+    private:
+        /// @brief Stored element in the tenant's deque
+        struct queued_item
+        {
+            queued_item(T&& i)
+                : item(std::move(i))
+            {
+            }
+
+            T                                     item;
+            std::chrono::steady_clock::time_point queuedAt {std::chrono::steady_clock::now()};
+        };
+
+        /// @brief The per-tenant sub-queue and its DRR state
+        struct tenant_queue
+        {
+            std::deque<queued_item> items {};
+            uint32_t                weight {1};
+            int64_t                 deficit {0};
+            bool                    active {false};
+            uint64_t                queueCounter {0};
+            queue_gauges            gauges {};
+
+            /// @brief Must be invoked with the lock held
+            queue_stats snapshot() const
+            {
+                return gauges.snapshot(queueCounter,
+                                       items.empty() ? std::chrono::microseconds(0)
+                                                     : std::chrono::duration_cast<std::chrono::microseconds>(
+                                                               std::chrono::steady_clock::now() - items.front().queuedAt));
+            }
+        };
+
+        /// @brief The dequeued item along with its tenant (for the per-tenant counters)
+        struct dispatched_item
+        {
+            T             item;
+            tenant_queue* tenant;
+        };
+
+        std::atomic_uint64_t                queueCounter {0};
+        /// @brief Tenants are never erased so the pointers in the active list remain valid
+        std::unordered_map<K, tenant_queue> tenants {};
+        /// @brief The DRR round; tenants with backlog in the order they are to be served
+        std::deque<tenant_queue*>           active {};
+        mutable std::shared_mutex           items_mutex;
+        std::counting_semaphore<>           signal {0};
+        std::function<void(T&&)>            callback;
+        /// @brief This is the interval we wait on the signal; reduced to zero on shutdown
+        std::chrono::milliseconds           signalWaitInterval {1500};
+        std::vector<std::jthread>           workers {};
+
+
+        /// @brief Waits on the semaphore and if successful picks the next item using deficit round robin
+        /// @return An optional which may contain the item or empty (most of the time it'll be empty)
+        std::optional<dispatched_item> getNextItem()
+        {
+            if (!signal.try_acquire_for(signalWaitInterval)) return {};
+
+            std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+            // Guard against empty signals which are terminating indicator
+            if (active.empty()) return {};
+
+            auto* tq = active.front();
+            // The tenant at the front of the round receives its quantum when it has used up its deficit
+            if (tq->deficit <= 0) tq->deficit += tq->weight;
+
+            dispatched_item next {std::move(tq->items.front().item), tq};
+            tq->items.pop_front();
+            tq->gauges.popped();
+            tq->deficit--;
+
+            if (tq->items.empty()) {
+                // No backlog; leave the round and forfeit the remaining deficit
+                tq->active  = false;
+                tq->deficit = 0;
+                active.pop_front();
+            }
+            else if (tq->deficit <= 0) {
+                // Quantum exhausted; move to the back of the round
+                active.pop_front();
+                active.push_back(tq);
+            }
+
+            return next;
+        }
+
+        /// @brief Invokes the callback and updates the tenant's counters
+        void invoke(dispatched_item&& entry)
+        {
+            const auto started = std::chrono::steady_clock::now();
+            try {
+                callback(std::move(entry.item));
+                entry.tenant->gauges.processed++;
+            }
+            catch (...) {
+                entry.tenant->gauges.failed++;
+                entry.tenant->gauges.busy(std::chrono::steady_clock::now() - started);
+                throw;
+            }
+            entry.tenant->gauges.busy(std::chrono::steady_clock::now() - started);
+        }
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the fair_pool
+    /// @param dest destination json object
+    /// @param src source object
+    template <typename T, uint16_t N = 0, typename K = std::string>
+    static void to_json(nlohmann::json& dest, const siddiqsoft::fair_pool<T, N, K>& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+
+} // namespace siddiqsoft
+#endif // !FAIR_POOL_HPP
@@ -0,0 +1,144 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+
+namespace siddiqsoft
+{
+    /// @brief Snapshot of a latency_histogram. Bucket zero holds samples under 1us; bucket i holds samples in [2^(i-1), 2^i) us.
+    /// Snapshots from several histograms may be summed to compute aggregate percentiles.
+    struct latency_counts
+    {
+        static constexpr size_t Buckets = 40;
+
+        std::array<uint64_t, Buckets> buckets {};
+
+        /// @brief Total number of samples
+        uint64_t count() const noexcept
+        {
+            uint64_t total {0};
+            for (auto b : buckets) total += b;
+            return total;
+        }
+
+        /// @brief Approximate percentile; reports the upper bound of the bucket holding the requested rank
+        /// @param p The percentile in the range [0, 100]
+        /// @return Zero when there are no samples
+        std::chrono::microseconds percentile(double p) const noexcept
+        {
+            const auto total = count();
+            if (total == 0) return std::chrono::microseconds(0);
+
+            const auto rank = static_cast<uint64_t>((p / 100.0) * static_cast<double>(total - 1)) + 1;
+            uint64_t   seen {0};
+            for (size_t i = 0; i < Buckets; i++) {
+                seen += buckets[i];
+                if (seen >= rank) return std::chrono::microseconds(i == 0 ? 1 : (1LL << i));
+            }
+            return std::chrono::microseconds(1LL << (Buckets - 1));
+        }
+
+        latency_counts& operator+=(const latency_counts& other) noexcept
+        {
+            for (size_t i = 0; i < Buckets; i++) buckets[i] += other.buckets[i];
+            return *this;
+        }
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json; reports the common percentiles in microseconds
+        nlohmann::json toJson() const
+        {
+            return {{"count", count()},
+                    {"p50", percentile(50).count()},
+                    {"p90", percentile(90).count()},
+                    {"p99", percentile(99).count()},
+                    {"p999", percentile(99.9).count()}};
+        }
+#endif
+    };
+
+
+    /// @brief Lock-free log2 histogram (microsecond resolution) used to track service and wait times.
+    /// @remarks record() is a single relaxed increment so it may be invoked from any number of threads.
+    struct latency_histogram
+    {
+        /// @brief Record a single sample
+        void record(std::chrono::steady_clock::duration elapsed) noexcept
+        {
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            const auto i  = us <= 0 ? 0 : std::min<size_t>(std::bit_width(static_cast<uint64_t>(us)), latency_counts::Buckets - 1);
+            buckets[i].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// @brief Capture the current counts
+        latency_counts counts() const noexcept
+        {
+            latency_counts result {};
+            for (size_t i = 0; i < latency_counts::Buckets; i++) {
+                result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+            }
+            return result;
+        }
+
+        /// @brief Clear all of the samples
+        void reset() noexcept
+        {
+            for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::array<std::atomic_uint64_t, latency_counts::Buckets> buckets {};
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the latency_counts
+    /// @param dest destination json object
+    /// @param src source object
+    inline void to_json(nlohmann::json& dest, const siddiqsoft::latency_counts& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+} // namespace siddiqsoft
+#endif // !LATENCY_HISTOGRAM_HPP
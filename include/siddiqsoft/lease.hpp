@@ -0,0 +1,157 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef LEASE_HPP
+#define LEASE_HPP
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace siddiqsoft
+{
+    /**
+     * @brief RAII handle for an element checked out of a pool; the element is checked back in when the lease is destroyed
+     *        (including during stack unwinding) so it is never lost.
+     *        The lease holds the element by value along with a pointer to the pool; there is no allocation and no type-erased
+     *        deleter. Obtain one via pool.acquire().
+     * @tparam Pool The pool type; must provide value_type and checkin(value_type&&)
+     * @remarks The pool must outlive the lease. Use discard() to destroy an element which must not go back into the pool (for
+     *          instance a broken connection) so a factory-backed pool may replace it. release() only detaches the element; on a
+     *          factory-backed pool it must be followed by pool.discard() or the element keeps its maxTotal slot.
+     */
+    template <typename Pool>
+    class lease
+    {
+    public:
+        using value_type = typename Pool::value_type;
+
+        lease() = default;
+
+        lease(Pool& pool, value_type&& item) noexcept(std::is_nothrow_move_constructible_v<value_type>)
+            : _pool(std::addressof(pool))
+            , _item(std::move(item))
+        {
+        }
+
+        lease(lease&)            = delete;
+        lease& operator=(lease&) = delete;
+
+        lease(lease&& src) noexcept(std::is_nothrow_move_constructible_v<value_type>)
+            : _pool(std::exchange(src._pool, nullptr))
+            , _item(std::move(src._item))
+        {
+        }
+
+        lease& operator=(lease&& src) noexcept(std::is_nothrow_move_assignable_v<value_type>)
+        {
+            if (this != &src) {
+                reset();
+                _pool = std::exchange(src._pool, nullptr);
+                _item = std::move(src._item);
+            }
+            return *this;
+        }
+
+        ~lease()
+        {
+            reset();
+        }
+
+        /// @brief True while the lease holds an element
+        explicit operator bool() const noexcept
+        {
+            return _pool != nullptr;
+        }
+
+        value_type& get() noexcept
+        {
+            return _item;
+        }
+
+        const value_type& get() const noexcept
+        {
+            return _item;
+        }
+
+        value_type& operator*() noexcept
+        {
+            return _item;
+        }
+
+        /// @brief For pointer-like elements (shared_ptr, unique_ptr) this forwards to the element's operator-> so that
+        /// `lease->method()` reaches the pointee.
+        decltype(auto) operator->() noexcept
+        {
+            if constexpr (requires(value_type& v) { v.operator->(); } || std::is_pointer_v<value_type>)
+                return (_item);
+            else
+                return std::addressof(_item);
+        }
+
+        /// @brief Returns the element to the pool now
+        void reset() noexcept
+        {
+            if (_pool != nullptr) {
+                try {
+                    std::exchange(_pool, nullptr)->checkin(std::move(_item));
+                }
+                catch (...) {
+                    // The pool refused the element (for instance a full bounded pool); the element is destroyed
+                }
+            }
+        }
+
+        /// @brief Destroys the element via the pool's discard() instead of returning it (the pool may create a replacement)
+        void discard()
+            requires requires(Pool& p, value_type&& v) { p.discard(std::move(v)); }
+        {
+            if (_pool != nullptr) std::exchange(_pool, nullptr)->discard(std::move(_item));
+        }
+
+        /// @brief Detaches the element from the lease; it will not be returned to the pool
+        /// @remarks On a factory-backed pool hand the element to pool.discard() once done with it (or use discard() instead)
+        [[nodiscard]] value_type release() noexcept(std::is_nothrow_move_constructible_v<value_type>)
+        {
+            _pool = nullptr;
+            return std::move(_item);
+        }
+
+    private:
+        Pool*      _pool {nullptr};
+        value_type _item {};
+    };
+} // namespace siddiqsoft
+#endif // !LEASE_HPP
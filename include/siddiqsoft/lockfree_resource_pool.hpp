@@ -0,0 +1,227 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef LOCKFREE_RESOURCE_POOL_HPP
+#define LOCKFREE_RESOURCE_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "lease.hpp"
+
+namespace siddiqsoft
+{
+    /**
+     * @brief Bounded lock-free variant of resource_pool with the same API.
+     *        The elements are stored in a fixed array of slots managed as a multi-producer/multi-consumer ring (Vyukov).
+     *        checkout() and checkin() each claim a slot with a single compare-exchange on their own cache line and never
+     *        take a lock (they only yield while a concurrent call is half way through the same slot); use it for pools of
+     *        handles (shared_ptr, unique_ptr) hit from many threads.
+     * @tparam T The storage element type. Maybe shared_ptr or unique_ptr
+     *         The move constructor must not throw since the element is moved while a slot is claimed.
+     * @remarks Unlike resource_pool the capacity is fixed at construction (rounded up to a power of two) and checkin() into a
+     *          full pool throws std::overflow_error leaving the argument untouched.
+     */
+    template <typename T>
+        requires std::is_nothrow_move_constructible_v<T>
+    class lockfree_resource_pool
+    {
+    private:
+        /// @brief The sequence tells the producers/consumers whether the slot is free or holds an element for this lap
+        struct slot
+        {
+            std::atomic_size_t sequence {0};
+            alignas(T) std::byte storage[sizeof(T)];
+
+            T* element() noexcept
+            {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        size_t                   _mask;
+        std::unique_ptr<slot[]>  _slots;
+        alignas(64) std::atomic_size_t _enqueuePos {0};
+        alignas(64) std::atomic_size_t _dequeuePos {0};
+
+    public:
+        using value_type = T;
+
+        /**
+         * @brief Constructs the pool with room for at least capacity elements
+         *
+         * @param capacity Maximum number of elements held by the pool; rounded up to a power of two
+         */
+        explicit lockfree_resource_pool(size_t capacity = 1024)
+            : _mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+            , _slots(std::make_unique<slot[]>(_mask + 1))
+        {
+            for (size_t i = 0; i <= _mask; i++) {
+                _slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        lockfree_resource_pool(lockfree_resource_pool&)            = delete;
+        lockfree_resource_pool(lockfree_resource_pool&&)           = delete;
+        lockfree_resource_pool& operator=(lockfree_resource_pool&) = delete;
+        lockfree_resource_pool& operator=(lockfree_resource_pool&&) = delete;
+
+        ~lockfree_resource_pool()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            while (auto item = tryDequeue()) {
+                // Destroyed as it goes out of scope
+            }
+        }
+
+        /// @brief Approximate number of elements in the pool; exact when there are no concurrent callers
+        size_t size() const noexcept
+        {
+            const auto tail = _enqueuePos.load(std::memory_order_acquire);
+            const auto head = _dequeuePos.load(std::memory_order_acquire);
+            return (tail > head) ? tail - head : 0;
+        }
+
+        /// @brief Maximum number of elements held by the pool
+        size_t capacity() const noexcept
+        {
+            return _mask + 1;
+        }
+
+        [[nodiscard]] T checkout() /* throw() */
+        {
+            if (auto item = tryDequeue(); item) return std::move(*item);
+
+            throw std::runtime_error("Empty pool; add something first!");
+        }
+
+        /**
+         * @brief Checkout an element if one is available without blocking and without throwing
+         *
+         * @return The element or empty if the pool is empty
+         */
+        [[nodiscard]] std::optional<T> try_checkout() noexcept
+        {
+            return tryDequeue();
+        }
+
+        /**
+         * @brief Checkout an element wrapped in a lease which checks it back in on destruction
+         *
+         * @return lease holding the element
+         */
+        [[nodiscard]] lease<lockfree_resource_pool> acquire() /* throw() */
+        {
+            return {*this, checkout()};
+        }
+
+        /**
+         * @brief Insert a new element or return a borrowed element
+         *
+         * @param rsrc R-Value for the item to return to the pool (previously checkout'd or create a new one!)
+         * @throws std::overflow_error if the pool is at capacity; rsrc is not moved from
+         */
+        void checkin(T&& rsrc)
+        {
+            size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                auto&      s   = _slots[pos & _mask];
+                const auto seq = s.sequence.load(std::memory_order_acquire);
+                const auto dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if (dif == 0) {
+                    if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        ::new (static_cast<void*>(s.storage)) T(std::move(rsrc));
+                        s.sequence.store(pos + 1, std::memory_order_release);
+                        return;
+                    }
+                }
+                else if (dif < 0) {
+                    // The slot is still occupied; either the pool is full or a checkout has claimed it but not yet vacated it
+                    const auto used = static_cast<std::ptrdiff_t>(pos - _dequeuePos.load(std::memory_order_acquire));
+                    if (used > static_cast<std::ptrdiff_t>(_mask)) {
+                        throw std::overflow_error("Full pool; capacity exceeded!");
+                    }
+                    std::this_thread::yield();
+                    pos = _enqueuePos.load(std::memory_order_relaxed);
+                }
+                else {
+                    pos = _enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        /// @brief Claims the slot at the head (if any) and moves its element out
+        std::optional<T> tryDequeue() noexcept
+        {
+            size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                auto&      s   = _slots[pos & _mask];
+                const auto seq = s.sequence.load(std::memory_order_acquire);
+                const auto dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+                if (dif == 0) {
+                    if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        std::optional<T> item {std::move(*s.element())};
+                        s.element()->~T();
+                        s.sequence.store(pos + _mask + 1, std::memory_order_release);
+                        return item;
+                    }
+                }
+                else if (dif < 0) {
+                    // The slot is empty; either the pool is empty or a checkin has claimed it but not yet filled it
+                    if (_enqueuePos.load(std::memory_order_acquire) == pos) return std::nullopt;
+                    std::this_thread::yield();
+                    pos = _dequeuePos.load(std::memory_order_relaxed);
+                }
+                else {
+                    pos = _dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+} // namespace siddiqsoft
+#endif // !LOCKFREE_RESOURCE_POOL_HPP
@@ -0,0 +1,239 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef MAGAZINE_POOL_HPP
+#define MAGAZINE_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "resource_pool.hpp"
+
+namespace siddiqsoft
+{
+    /**
+     * @brief A resource_pool fronted by small per-thread caches ("magazines").
+     *        checkout() first pops from the calling thread's magazine and checkin() pushes into it; the shared resource_pool
+     *        (the depot) is only touched when the magazine is empty (checkout) or full (half of it is returned to the depot).
+     *        When a thread pairs checkout with checkin (the common case) there is no shared-state traffic at all.
+     * @tparam T The storage element type. Maybe shared_ptr or unique_ptr
+     * @tparam MagazineSize Maximum number of elements cached per thread
+     * @remarks Elements cached in a thread's magazine are not available to the other threads; the magazine is returned to the
+     *          depot when the thread exits (or via flush()). If the pool is destroyed first, the elements still cached by other
+     *          threads are destroyed when those threads exit.
+     */
+    template <typename T, size_t MagazineSize = 8>
+        requires std::move_constructible<T> && (MagazineSize > 0)
+    class magazine_pool
+    {
+    private:
+        /// @brief Owned by the pool and referenced weakly by the magazines so they can outlive it
+        struct shared_state
+        {
+            resource_pool<T> depot {};
+            uint64_t         id {0};
+        };
+
+        struct magazine
+        {
+            uint64_t                    poolId {0};
+            std::weak_ptr<shared_state> owner {};
+            std::vector<T>              items {};
+        };
+
+        /// @brief The calling thread's magazines; one per pool the thread has used
+        struct magazine_cache
+        {
+            std::vector<magazine> magazines {};
+
+            ~magazine_cache()
+            {
+                for (auto& m : magazines) {
+                    if (auto s = m.owner.lock(); s) {
+                        for (auto& item : m.items) s->depot.checkin(std::move(item));
+                    }
+                }
+            }
+        };
+
+        std::shared_ptr<shared_state> _state {};
+
+    public:
+        using value_type = T;
+
+        magazine_pool()
+            : _state(std::make_shared<shared_state>())
+        {
+            static std::atomic_uint64_t nextPoolId {1};
+            _state->id = nextPoolId.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        magazine_pool(magazine_pool&)            = delete;
+        magazine_pool(magazine_pool&&)           = delete;
+        magazine_pool& operator=(magazine_pool&) = delete;
+        magazine_pool& operator=(magazine_pool&&) = delete;
+
+        /// @brief Removes the elements in the depot and in the calling thread's magazine
+        void clear()
+        {
+            localMagazine().items.clear();
+            _state->depot.clear();
+        }
+
+        /// @brief Number of elements available to the calling thread: the depot plus the calling thread's magazine
+        auto size()
+        {
+            return _state->depot.size() + localMagazine().items.size();
+        }
+
+        [[nodiscard]] T checkout() /* throw() */
+        {
+            if (auto& m = localMagazine(); !m.items.empty()) {
+                T item {std::move(m.items.back())};
+                m.items.pop_back();
+                return item;
+            }
+
+            // Magazine is empty; go to the depot (throws if it is empty too)
+            return _state->depot.checkout();
+        }
+
+        /**
+         * @brief Checkout an element if one is available without blocking and without throwing
+         *
+         * @return The element or empty if both the magazine and the depot are empty
+         */
+        [[nodiscard]] std::optional<T> try_checkout()
+        {
+            if (auto& m = localMagazine(); !m.items.empty()) {
+                std::optional<T> item {std::move(m.items.back())};
+                m.items.pop_back();
+                return item;
+            }
+
+            return _state->depot.try_checkout();
+        }
+
+        /**
+         * @brief Checkout an element, waiting on the depot up to the timeout when the calling thread's magazine is empty
+         *
+         * @param timeout Maximum time to wait
+         * @return The element or empty if the timeout expired
+         */
+        template <class Rep, class Period>
+        [[nodiscard]] std::optional<T> checkout_for(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if (auto& m = localMagazine(); !m.items.empty()) {
+                std::optional<T> item {std::move(m.items.back())};
+                m.items.pop_back();
+                return item;
+            }
+
+            return _state->depot.checkout_for(timeout);
+        }
+
+        /**
+         * @brief Checkout an element wrapped in a lease which checks it back in on destruction
+         *
+         * @return lease holding the element
+         */
+        [[nodiscard]] lease<magazine_pool> acquire() /* throw() */
+        {
+            return {*this, checkout()};
+        }
+
+        /**
+         * @brief Insert a new element or return a borrowed element
+         *
+         * @param rsrc R-Value for the item to return to the pool (previously checkout'd or create a new one!)
+         */
+        void checkin(T&& rsrc)
+        {
+            auto& m = localMagazine();
+            if (m.items.size() == MagazineSize) {
+                // Magazine is full; return the older half to the depot and keep the recently used (warm) elements
+                const size_t spill = (MagazineSize + 1) / 2;
+                for (size_t i = 0; i < spill; i++) _state->depot.checkin(std::move(m.items[i]));
+                m.items.erase(m.items.begin(), m.items.begin() + spill);
+            }
+            m.items.push_back(std::move(rsrc));
+        }
+
+        /**
+         * @brief Destroys a checked out element which must not return to the pool so the depot's factory may replace it
+         *
+         * @param rsrc R-Value for the item previously checkout'd
+         */
+        void discard(T&& rsrc)
+        {
+            _state->depot.discard(std::move(rsrc));
+        }
+
+        /// @brief Returns the calling thread's magazine to the depot so the other threads may use those elements
+        void flush()
+        {
+            auto& m = localMagazine();
+            for (auto& item : m.items) _state->depot.checkin(std::move(item));
+            m.items.clear();
+        }
+
+    private:
+        static magazine_cache& threadCache()
+        {
+            thread_local magazine_cache cache {};
+            return cache;
+        }
+
+        /// @brief Finds (or creates) the calling thread's magazine for this pool
+        magazine& localMagazine()
+        {
+            auto& cache = threadCache();
+            for (auto& m : cache.magazines) {
+                if (m.poolId == _state->id) return m;
+            }
+
+            // First use by this thread; drop the magazines of the pools which no longer exist
+            std::erase_if(cache.magazines, [](const magazine& m) { return m.owner.expired(); });
+            auto& m = cache.magazines.emplace_back(_state->id, _state, std::vector<T> {});
+            m.items.reserve(MagazineSize);
+            return m;
+        }
+    };
+} // namespace siddiqsoft
+#endif // !MAGAZINE_POOL_HPP
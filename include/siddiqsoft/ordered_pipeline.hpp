@@ -0,0 +1,268 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef ORDERED_PIPELINE_HPP
+#define ORDERED_PIPELINE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "simple_pool.hpp"
+
+
+namespace siddiqsoft
+{
+    /// @brief Transforms items in parallel (on a simple_pool) while delivering the results to the output callback strictly in
+    /// the order the items were queued.
+    /// Each item is assigned a sequence number by queue(); the transformed results are parked in a bounded reorder buffer and
+    /// handed to the output callback as soon as the gap before them closes.
+    /// @tparam In The input type
+    /// @tparam Out The result of the transform
+    /// @tparam N Number of threads in the pool. Leave it to 0 to use the value returned by std::thread::hardware_concurrency()
+    /// @remarks The output callback is never invoked concurrently. If the transform throws, that sequence number is skipped
+    /// (counted as failed) so the subsequent results are not held up.
+    template <typename In, typename Out, uint16_t N = 0>
+        requires std::is_move_constructible_v<In> && std::is_move_constructible_v<Out>
+    struct ordered_pipeline
+    {
+        ordered_pipeline(ordered_pipeline&&)            = delete;
+        ordered_pipeline& operator=(ordered_pipeline&&) = delete;
+        ordered_pipeline(ordered_pipeline&)             = delete;
+        ordered_pipeline& operator=(ordered_pipeline&)  = delete;
+
+        /// @brief Constructs the pipeline
+        /// @param t The transform; invoked in parallel on the pool threads
+        /// @param o The output callback; receives the results in the order they were queued
+        /// @param window Size of the reorder buffer. At most this many items may be in flight (queued but not yet delivered);
+        /// queue() blocks once the window is full which bounds the memory held by a slow item at the head.
+        ordered_pipeline(std::function<Out(In&&)> t, std::function<void(Out&&)> o, size_t window = 1024)
+            : transform(std::move(t))
+            , output(std::move(o))
+            , slots(window)
+            , windowSlots(static_cast<std::ptrdiff_t>(window))
+        {
+            if (window == 0) throw std::invalid_argument("ordered_pipeline requires a window of at least one item");
+        }
+
+        /// @brief Queue the item for transformation
+        /// @param item Item to queue must be move'd
+        /// @remarks Blocks while the reorder window is full (backpressure). With multiple producers the output order is the
+        /// order in which their queue() calls were sequenced.
+        /// When invoked from within the output callback (which is what frees the window) the call never blocks: if the window
+        /// is full the item is deferred and admitted, ahead of the blocked producers, as the results being delivered free
+        /// their slots.
+        void queue(In&& item)
+        {
+            if (emitter.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                if (!windowSlots.try_acquire()) {
+                    std::lock_guard<std::mutex> myReorderLock(reorder_mutex);
+                    deferred.push_back(std::move(item));
+                    deferredCounter++;
+                    return;
+                }
+            }
+            else {
+                windowSlots.acquire();
+            }
+            pool.queue({nextSequence.fetch_add(1), std::move(item)});
+        }
+
+        /// @brief Number of items queued but not yet delivered (or skipped)
+        uint64_t pending() const noexcept
+        {
+            return nextSequence.load() - completedCounter.load() + deferredCounter.load();
+        }
+
+        /// @brief Number of results delivered to the output callback
+        uint64_t delivered() const noexcept
+        {
+            return deliveredCounter.load();
+        }
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            return {{"_typver", "siddiqsoft.asynchrony-lib.ordered_pipeline/0.10"},
+                    {"window", slots.size()},
+                    {"queueCounter", nextSequence.load()},
+                    {"deliveredCounter", deliveredCounter.load()},
+                    {"failedCounter", failedCounter.load()},
+                    {"outputFailedCounter", outputFailedCounter.load()},
+                    {"pending", pending()},
+                    {"pool", pool.toJson()}};
+        }
+#endif
+
+    private:
+        /// @brief The item along with its position in the output order
+        struct sequenced_item
+        {
+            uint64_t sequence;
+            In       item;
+        };
+
+        /// @brief A slot in the reorder buffer
+        struct reorder_slot
+        {
+            bool               ready {false};
+            std::optional<Out> result {};
+        };
+
+        std::function<Out(In&&)>    transform;
+        std::function<void(Out&&)>  output;
+        /// @brief The reorder buffer; sequence s lives at slots[s % window]. The window semaphore guarantees that no more than
+        /// window sequences are outstanding so the slots never collide.
+        std::vector<reorder_slot>   slots;
+        std::counting_semaphore<>   windowSlots;
+        std::mutex                  reorder_mutex {};
+        /// @brief The next sequence to hand to the output callback; guarded by reorder_mutex
+        uint64_t                    nextToDeliver {0};
+        /// @brief Set while one of the threads is draining the reorder buffer; guarded by reorder_mutex
+        bool                        delivering {false};
+        /// @brief The thread draining the reorder buffer (invoking the output callback)
+        std::atomic<std::thread::id> emitter {};
+        /// @brief Items queued from within the output callback while the window was full; guarded by reorder_mutex
+        std::deque<In>              deferred {};
+        std::atomic_uint64_t        deferredCounter {0};
+        std::atomic_uint64_t        nextSequence {0};
+        std::atomic_uint64_t        completedCounter {0};
+        std::atomic_uint64_t        deliveredCounter {0};
+        std::atomic_uint64_t        failedCounter {0};
+        std::atomic_uint64_t        outputFailedCounter {0};
+        /// @brief Declared last so the threads are joined before the reorder buffer is destroyed
+        simple_pool<sequenced_item, N> pool {[this](sequenced_item&& s) { process(std::move(s)); }};
+
+
+        /// @brief Runs the transform on a pool thread and deposits the result into the reorder buffer
+        void process(sequenced_item&& s)
+        {
+            std::optional<Out> result {};
+            try {
+                result.emplace(transform(std::move(s.item)));
+            }
+            catch (...) {
+                failedCounter++;
+            }
+            complete(s.sequence, std::move(result));
+        }
+
+        /// @brief Parks the result and, unless another thread is already doing so, delivers the contiguous run of ready results.
+        /// @param sequence The sequence number of the result
+        /// @param result The result; empty if the transform failed (the sequence is skipped)
+        /// @remarks The output callback is invoked outside of the lock so the other threads may continue to deposit results
+        /// while a slow output is in progress.
+        void complete(uint64_t sequence, std::optional<Out>&& result)
+        {
+            std::vector<std::optional<Out>> batch {};
+            std::unique_lock<std::mutex>    myReorderLock(reorder_mutex);
+
+            auto& slot  = slots[sequence % slots.size()];
+            slot.result = std::move(result);
+            slot.ready  = true;
+            if (delivering) return;
+
+            delivering = true;
+            emitter.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            for (;;) {
+                while (slots[nextToDeliver % slots.size()].ready) {
+                    auto& head = slots[nextToDeliver % slots.size()];
+                    batch.emplace_back(std::move(head.result));
+                    head.result.reset();
+                    head.ready = false;
+                    nextToDeliver++;
+                }
+                if (batch.empty()) break;
+
+                myReorderLock.unlock();
+                for (auto& r : batch) {
+                    if (r) {
+                        try {
+                            output(std::move(*r));
+                            deliveredCounter++;
+                        }
+                        catch (...) {
+                            outputFailedCounter++;
+                        }
+                    }
+                }
+                completedCounter += batch.size();
+                auto freed = batch.size();
+                batch.clear();
+                myReorderLock.lock();
+
+                // The freed slots go to the items deferred by the output callback first
+                std::vector<In> admitted {};
+                while ((freed > 0) && !deferred.empty()) {
+                    admitted.emplace_back(std::move(deferred.front()));
+                    deferred.pop_front();
+                    freed--;
+                }
+                if (freed > 0) windowSlots.release(static_cast<std::ptrdiff_t>(freed));
+                if (!admitted.empty()) {
+                    myReorderLock.unlock();
+                    for (auto& item : admitted) {
+                        pool.queue({nextSequence.fetch_add(1), std::move(item)});
+                        deferredCounter--;
+                    }
+                    myReorderLock.lock();
+                }
+            }
+            emitter.store(std::thread::id {}, std::memory_order_relaxed);
+            delivering = false;
+        }
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the ordered_pipeline
+    /// @param dest destination json object
+    /// @param src source object
+    template <typename In, typename Out, uint16_t N = 0>
+    static void to_json(nlohmann::json& dest, const siddiqsoft::ordered_pipeline<In, Out, N>& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+
+} // namespace siddiqsoft
+#endif // !ORDERED_PIPELINE_HPP
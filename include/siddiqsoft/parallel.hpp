@@ -0,0 +1,198 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <latch>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+#include "task_pool.hpp"
+
+
+namespace siddiqsoft
+{
+    namespace detail
+    {
+        /// @brief Splits the index range [0, count) into chunks of `grain` items and executes `body(begin, end)` for every chunk
+        /// on the pool threads *and* the calling thread. Returns once every chunk has completed.
+        /// @param pool The task_pool whose (warm) threads help with the chunks
+        /// @param count Number of items
+        /// @param grain Number of items per chunk; 0 is treated as 1
+        /// @param body Invoked as body(size_t begin, size_t end) for each chunk
+        /// @remarks Chunks are claimed dynamically from a shared counter so a slow chunk does not hold up the rest. The first
+        /// exception thrown by any chunk is re-thrown on the calling thread after all the helpers have finished.
+        /// Since the caller helps drain the pool, it is safe to nest these algorithms inside a task on the same pool.
+        template <uint16_t N, typename Body>
+        void parallel_chunks(task_pool<N>& pool, const size_t count, size_t grain, Body&& body)
+        {
+            if (count == 0) return;
+            if (grain == 0) grain = 1;
+
+            const size_t       chunks = (count + grain - 1) / grain;
+            std::atomic_size_t nextChunk {0};
+            std::atomic_bool   failed {false};
+            std::exception_ptr error {};
+
+            auto runChunks = [&]() {
+                for (size_t c = nextChunk++; c < chunks; c = nextChunk++) {
+                    // Once we've failed we continue to claim the remaining chunks but skip them
+                    if (failed.load(std::memory_order_relaxed)) continue;
+                    try {
+                        body(c * grain, std::min(count, (c + 1) * grain));
+                    }
+                    catch (...) {
+                        if (!failed.exchange(true)) error = std::current_exception();
+                    }
+                }
+            };
+
+            // The calling thread is one of the participants so we only need (chunks - 1) helpers.
+            const auto     helpers = static_cast<std::ptrdiff_t>(std::min(chunks - 1, pool.threadCount()));
+            std::latch     done {helpers};
+            std::ptrdiff_t queued {0};
+
+            try {
+                for (; queued < helpers; queued++) {
+                    pool.queue([&runChunks, &done]() {
+                        runChunks();
+                        done.count_down();
+                    });
+                }
+            }
+            catch (...) {
+                // Could not queue all of the helpers; account for them so we do not wait forever.
+                done.count_down(helpers - queued);
+            }
+
+            runChunks();
+            // Rather than idle while the helpers finish, execute whatever is queued ahead of them. Once there is nothing left in
+            // the deque every helper has been picked up and we may block.
+            while (!done.try_wait()) {
+                if (pool.run_pending(1) == 0) {
+                    done.wait();
+                    break;
+                }
+            }
+
+            if (error) std::rethrow_exception(error);
+        }
+    } // namespace detail
+
+
+    /// @brief Invokes fn on every element of the range using the task_pool threads and the calling thread
+    /// @param pool The task_pool
+    /// @param range Random access range whose elements are passed by reference to fn
+    /// @param grain Number of elements processed per task
+    /// @param fn Invoked as fn(element) from multiple threads
+    template <uint16_t N, std::ranges::random_access_range R, typename Fn>
+        requires std::invocable<Fn&, std::ranges::range_reference_t<R>>
+    void parallel_for(task_pool<N>& pool, R&& range, size_t grain, Fn&& fn)
+    {
+        auto first = std::ranges::begin(range);
+
+        detail::parallel_chunks(pool, static_cast<size_t>(std::ranges::distance(range)), grain, [&](size_t b, size_t e) {
+            for (auto i = b; i < e; i++) {
+                fn(first[i]);
+            }
+        });
+    }
+
+
+    /// @brief Stores fn(element) for every element of the range into the output using the task_pool threads and the calling
+    /// thread
+    /// @param pool The task_pool
+    /// @param range Random access range of the source elements
+    /// @param out Random access iterator to the start of the destination; must have room for the entire range
+    /// @param grain Number of elements processed per task
+    /// @param fn Invoked as fn(element) from multiple threads
+    /// @return Iterator past the last element written
+    template <uint16_t N, std::ranges::random_access_range R, std::random_access_iterator Out, typename Fn>
+        requires std::invocable<Fn&, std::ranges::range_reference_t<R>>
+    Out parallel_transform(task_pool<N>& pool, R&& range, Out out, size_t grain, Fn&& fn)
+    {
+        auto       first = std::ranges::begin(range);
+        const auto count = static_cast<size_t>(std::ranges::distance(range));
+
+        detail::parallel_chunks(pool, count, grain, [&](size_t b, size_t e) {
+            for (auto i = b; i < e; i++) {
+                out[i] = fn(first[i]);
+            }
+        });
+
+        return out + count;
+    }
+
+
+    /// @brief Reduces the range using op with the task_pool threads and the calling thread
+    /// @param pool The task_pool
+    /// @param range Random access range whose elements are convertible to T
+    /// @param grain Number of elements processed per task
+    /// @param init Initial value
+    /// @param op Associative binary operation T op(T, T); the order in which the partial results are combined is unspecified
+    /// @return The reduced value
+    template <uint16_t N, std::ranges::random_access_range R, typename T, typename Op>
+        requires std::convertible_to<std::ranges::range_reference_t<R>, T> && std::invocable<Op&, T, T>
+    T parallel_reduce(task_pool<N>& pool, R&& range, size_t grain, T init, Op&& op)
+    {
+        auto       first = std::ranges::begin(range);
+        const auto count = static_cast<size_t>(std::ranges::distance(range));
+        if (grain == 0) grain = 1;
+
+        // One slot per chunk; each chunk writes only into its own slot
+        std::vector<std::optional<T>> partials((count + grain - 1) / grain);
+
+        detail::parallel_chunks(pool, count, grain, [&](size_t b, size_t e) {
+            T partial = static_cast<T>(first[b]);
+            for (auto i = b + 1; i < e; i++) {
+                partial = op(std::move(partial), static_cast<T>(first[i]));
+            }
+            partials[b / grain].emplace(std::move(partial));
+        });
+
+        for (auto& p : partials) {
+            init = op(std::move(init), std::move(*p));
+        }
+
+        return init;
+    }
+} // namespace siddiqsoft
+#endif // !PARALLEL_HPP
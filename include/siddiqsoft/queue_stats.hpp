@@ -0,0 +1,148 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef QUEUE_STATS_HPP
+#define QUEUE_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+namespace siddiqsoft
+{
+    /// @brief Snapshot of the gauges and counters for a worker queue (simple_worker, simple_pool, each roundrobin_pool worker).
+    /// @remarks The individual fields are read without stopping the producers/consumers so the snapshot is approximate
+    /// with respect to the other fields; each field on its own is accurate.
+    struct queue_stats
+    {
+        /// @brief Number of items currently waiting in the deque
+        uint64_t depth {0};
+        /// @brief Highest depth observed since construction or the last reset_peak()
+        uint64_t peakDepth {0};
+        /// @brief Total number of items ever queued
+        uint64_t queued {0};
+        /// @brief Number of callbacks which completed normally
+        uint64_t processed {0};
+        /// @brief Number of callbacks which threw an exception
+        uint64_t failed {0};
+        /// @brief Number of cancelled items which were skipped or purged
+        uint64_t skipped {0};
+        /// @brief Age of the item at the front of the deque (zero when empty); this is the backlog age
+        std::chrono::microseconds oldestItemAge {0};
+        /// @brief Total time spent inside the callback
+        std::chrono::microseconds busyTime {0};
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            return {{"depth", depth},
+                    {"peakDepth", peakDepth},
+                    {"queued", queued},
+                    {"processed", processed},
+                    {"failed", failed},
+                    {"skipped", skipped},
+                    {"oldestItemAgeUs", oldestItemAge.count()},
+                    {"busyTimeUs", busyTime.count()}};
+        }
+#endif
+    };
+
+
+    /// @brief The cheaply maintained gauges backing queue_stats. Owned by the worker/pool.
+    /// @remarks pushed() must be invoked while holding the deque lock (so the peak is updated by one thread at a time);
+    /// all of the other members may be invoked without a lock.
+    struct queue_gauges
+    {
+        std::atomic_uint64_t depth {0};
+        std::atomic_uint64_t peakDepth {0};
+        std::atomic_uint64_t processed {0};
+        std::atomic_uint64_t failed {0};
+        std::atomic_uint64_t skipped {0};
+        std::atomic_uint64_t busyMicros {0};
+
+        /// @brief Record items added into the deque
+        void pushed(uint64_t count = 1) noexcept
+        {
+            const auto d = depth.fetch_add(count, std::memory_order_relaxed) + count;
+            if (d > peakDepth.load(std::memory_order_relaxed)) peakDepth.store(d, std::memory_order_relaxed);
+        }
+
+        /// @brief Record items removed from the deque
+        void popped(uint64_t count = 1) noexcept
+        {
+            depth.fetch_sub(count, std::memory_order_relaxed);
+        }
+
+        /// @brief Record the time spent inside the callback
+        void busy(std::chrono::steady_clock::duration elapsed) noexcept
+        {
+            busyMicros.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), std::memory_order_relaxed);
+        }
+
+        /// @brief Restart the peak tracking from the current depth
+        void reset_peak() noexcept
+        {
+            peakDepth.store(depth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        /// @brief Capture the gauges into a snapshot
+        /// @param queued Total number of items queued (owned by the caller)
+        /// @param oldestItemAge Age of the item at the front of the deque
+        queue_stats snapshot(uint64_t queued, std::chrono::microseconds oldestItemAge) const noexcept
+        {
+            return {.depth         = depth.load(std::memory_order_relaxed),
+                    .peakDepth     = peakDepth.load(std::memory_order_relaxed),
+                    .queued        = queued,
+                    .processed     = processed.load(std::memory_order_relaxed),
+                    .failed        = failed.load(std::memory_order_relaxed),
+                    .skipped       = skipped.load(std::memory_order_relaxed),
+                    .oldestItemAge = oldestItemAge,
+                    .busyTime      = std::chrono::microseconds(busyMicros.load(std::memory_order_relaxed))};
+        }
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the queue_stats
+    /// @param dest destination json object
+    /// @param src source object
+    inline void to_json(nlohmann::json& dest, const siddiqsoft::queue_stats& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+} // namespace siddiqsoft
+#endif // !QUEUE_STATS_HPP
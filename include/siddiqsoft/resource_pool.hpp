@@ -39,18 +39,185 @@
 #include <stdexcept>
 #include <mutex>
 #include <shared_mutex>
+#include <condition_variable>
+#include <chrono>
 #include <deque>
+#include <optional>
+#include <functional>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <memory>
 
+#include "lease.hpp"
+#include "latency_histogram.hpp"
+#include "periodic_worker.hpp"
 #include "siddiqsoft/RunOnEnd.hpp"
 
 namespace siddiqsoft
 {
+    /// @brief The steady_clock time point a timeout from now expires at; rounds up (floating-point durations included) and
+    /// saturates at time_point::max() so that duration::max() waits forever instead of overflowing.
+    template <class Rep, class Period>
+    std::chrono::steady_clock::time_point deadline_after(std::chrono::steady_clock::time_point     now,
+                                                         const std::chrono::duration<Rep, Period>& timeout) noexcept
+    {
+        if (timeout <= std::chrono::duration<Rep, Period>::zero()) return now;
+        const auto headroom = std::chrono::steady_clock::time_point::max() - now;
+        if (std::chrono::duration<double>(timeout) >= std::chrono::duration<double>(headroom))
+            return std::chrono::steady_clock::time_point::max();
+        return now + std::min(headroom, std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+    }
+
+
+    /// @brief Order in which a resource_pool hands out its idle elements
+    enum class reuse_order
+    {
+        /// @brief Least recently returned first; rotates through every idle element
+        fifo,
+        /// @brief Most recently returned first; a small hot subset stays cache-warm and the rest ages out (see maxIdle)
+        lifo
+    };
+
+
+    /**
+     * @brief Optional configuration for a factory-backed resource_pool
+     * @tparam T The storage element type
+     */
+    template <typename T>
+    struct resource_pool_options
+    {
+        /// @brief Creates a new element when the pool is empty; leave empty for a pool which only holds what is checked in
+        std::function<T()> factory {};
+        /// @brief Number of idle elements created by prewarm() (invoke it at startup)
+        size_t minIdle {0};
+        /// @brief Upper bound for the number of elements created by the factory which are alive (idle plus checked out)
+        size_t maxTotal {std::numeric_limits<size_t>::max()};
+        /// @brief Idle elements unused for longer than this are evicted by the reaper (keeping minIdle); zero disables
+        std::chrono::milliseconds maxIdle {0};
+        /// @brief Elements older than this are evicted (by the reaper, on checkout and on checkin); zero disables
+        std::chrono::milliseconds maxLifetime {0};
+        /// @brief Health check for an element; return false (or throw) to have the element destroyed instead of handed out
+        std::function<bool(T&)> validator {};
+        /// @brief The validator is invoked on checkout only for elements idle (and not validated) for longer than this
+        std::chrono::milliseconds validateAfterIdle {0};
+        /// @brief How often the background reaper evicts, revalidates the idle elements and tops up to minIdle; zero disables
+        /// the reaper
+        std::chrono::milliseconds reapInterval {0};
+        /// @brief Track the checked out elements to record how long they are held and keep the outstanding count exact
+        /// (pointer-like elements only; costs a map update per checkout and checkin)
+        bool trackHeldTime {false};
+        /// @brief Which idle element is handed out first
+        reuse_order reuse {reuse_order::fifo};
+    };
+
+
+    /// @brief Snapshot of the resource_pool counters
+    struct resource_pool_stats
+    {
+        /// @brief Number of elements handed out (checkout, try_checkout, checkout_for and acquire)
+        uint64_t checkouts {0};
+        /// @brief Number of elements checked in
+        uint64_t checkins {0};
+        /// @brief Checkouts per second since the previous stats() snapshot (or construction)
+        double checkoutRate {0.0};
+        /// @brief Number of checkout attempts which found the pool empty (and had to create, wait or fail)
+        uint64_t emptyEvents {0};
+        /// @brief Number of elements currently checked out. Exact when the pool tracks the checked out elements (pointer-like
+        /// elements with trackHeldTime or maxLifetime); otherwise every checkin counts as a return, including new elements.
+        uint64_t outstanding {0};
+        /// @brief Highest number of elements checked out at once since construction or the last reset_peak()
+        uint64_t peakOutstanding {0};
+        /// @brief Time spent by the callers inside checkout (including the creation and the wait for a checkin)
+        latency_counts waitTime {};
+        /// @brief Time between checkout and checkin (see resource_pool_options::trackHeldTime)
+        latency_counts heldTime {};
+        /// @brief Number of idle elements in the pool
+        uint64_t idle {0};
+        /// @brief Number of factory created elements alive (idle, checked out or being created)
+        uint64_t total {0};
+        /// @brief Number of idle elements evicted for exceeding maxIdle
+        uint64_t evictedIdle {0};
+        /// @brief Number of elements evicted for exceeding maxLifetime
+        uint64_t evictedExpired {0};
+        /// @brief Number of elements destroyed because the validator rejected them
+        uint64_t failedValidation {0};
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            return {{"checkouts", checkouts},
+                    {"checkins", checkins},
+                    {"checkoutRate", checkoutRate},
+                    {"emptyEvents", emptyEvents},
+                    {"outstanding", outstanding},
+                    {"peakOutstanding", peakOutstanding},
+                    {"waitTimeUs", waitTime},
+                    {"heldTimeUs", heldTime},
+                    {"idle", idle},
+                    {"total", total},
+                    {"evictedIdle", evictedIdle},
+                    {"evictedExpired", evictedExpired},
+                    {"failedValidation", failedValidation}};
+        }
+#endif
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the resource_pool_stats
+    /// @param dest destination json object
+    /// @param src source object
+    inline void to_json(nlohmann::json& dest, const siddiqsoft::resource_pool_stats& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+
+
+    /**
+     * @brief The accounting of the elements which are alive and checked out. A resource_pool owns one unless it is given one to
+     *        share with the other pools its elements may be returned to (the shards of a sharded_resource_pool) so that any of
+     *        them may account for the return, eviction or discard of an element created or checked out by another.
+     */
+    struct resource_pool_ledger
+    {
+        /// @brief Creation and checkout time of a checked out element
+        struct checkout_record
+        {
+            std::chrono::steady_clock::time_point createdAt {};
+            std::chrono::steady_clock::time_point since {};
+        };
+
+        /// @brief Number of factory created elements alive (idle, checked out or being created)
+        std::atomic_size_t   total {0};
+        /// @brief Number of elements checked out
+        std::atomic_uint64_t outstanding {0};
+        std::atomic_uint64_t peakOutstanding {0};
+        /// @brief Guards checkedOut; taken after the pool's own lock
+        std::mutex           lock {};
+        /// @brief The checked out elements (keyed by the pointee) so that maxLifetime spans checkouts and the held time is known
+        std::unordered_map<const void*, checkout_record> checkedOut {};
+    };
+
+
     /**
      * @brief Implements a resource pool that stores objects of type T.
      *        Said objects can be shared_ptr or unique_ptr
      *        Client "acquire" and "release" T from this pool.
      *        The capacity of this pool should be kept at
      *        the same value as std::thread::hardware_concurrency()
+     *        See lockfree_resource_pool for a bounded lock-free variant with the same API.
+     *        When constructed with a factory the pool creates elements on demand (up to maxTotal). Creation is single-flight:
+     *        at most one factory call is in progress (outside of prewarm()) and the callers arriving meanwhile wait for it to
+     *        complete instead of stampeding the backend.
+     *        The pool records when each element was created and last used. Idle elements beyond maxIdle and elements beyond
+     *        maxLifetime are evicted by the background reaper (see resource_pool_options::reapInterval).
+     *        With a validator, elements idle for longer than validateAfterIdle are checked on checkout and the reaper
+     *        revalidates the idle elements in the background so that most checkouts do not pay for the check.
      * @tparam T The storage element type. Maybe shared_ptr or unique_ptr
      *         The only requirement is that the underlying object is move-constructible!
      * 
@@ -60,47 +227,332 @@ namespace siddiqsoft
     class resource_pool
     {
     private:
-        std::deque<T>        _pool {};
-        std::recursive_mutex _poolLock {};
+        /// @brief A caller parked in checkout_for(); lives on the caller's stack while it is in the waiters list
+        struct waiter
+        {
+            std::condition_variable signal {};
+            std::optional<T>        handoff {};
+            /// @brief Set when the waiter is woken (and removed from the list) to try to create an element itself
+            bool retry {false};
+        };
+
+        /// @brief The idle element along with its timestamps
+        struct envelope
+        {
+            T                                     item;
+            std::chrono::steady_clock::time_point createdAt {};
+            std::chrono::steady_clock::time_point lastUsed {};
+            std::chrono::steady_clock::time_point validatedAt {};
+        };
+
+        /// @brief Idle elements; the least recently used is at the front
+        std::deque<envelope>    _pool {};
+        mutable std::mutex      _poolLock {};
+        /// @brief Mirrors _pool.size() so that size() does not need the lock
+        std::atomic_size_t      _idleCount {0};
+        /// @brief Parked callers in arrival order; non-empty only while the pool is empty
+        std::deque<waiter*>     _waiters {};
+        resource_pool_options<T> _options {};
+        /// @brief The live and checked out elements; _ledger points at it unless the pool shares a ledger with other pools
+        resource_pool_ledger    _ownLedger {};
+        resource_pool_ledger*   _ledger {&_ownLedger};
+        /// @brief True while a (single-flight) factory call is in progress
+        bool                    _creating {false};
+        /// @brief Signalled when the in-progress factory call completes
+        std::condition_variable _created {};
+        std::atomic_uint64_t    _evictedIdle {0};
+        std::atomic_uint64_t    _evictedExpired {0};
+        std::atomic_uint64_t    _failedValidation {0};
+        std::atomic_uint64_t    _checkouts {0};
+        std::atomic_uint64_t    _checkins {0};
+        std::atomic_uint64_t    _emptyEvents {0};
+        latency_histogram       _waitTimes {};
+        latency_histogram       _heldTimes {};
+        /// @brief Start of the checkoutRate window and the checkouts at that time; guarded by _poolLock
+        mutable std::chrono::steady_clock::time_point _rateSince {std::chrono::steady_clock::now()};
+        mutable uint64_t                              _rateCheckouts {0};
 
     public:
+        using value_type = T;
+
         resource_pool()                               = default;
         resource_pool(resource_pool&)                 = delete;
         resource_pool(resource_pool&& src)            = default;
         resource_pool& operator=(resource_pool&)      = delete;
         resource_pool& operator=(resource_pool&& src) = default;
 
+        /**
+         * @brief Constructs a factory-backed pool. No elements are created until the first checkout or prewarm().
+         *
+         * @param options The factory and the limits
+         */
+        explicit resource_pool(resource_pool_options<T> options)
+            : resource_pool(std::move(options), _ownLedger)
+        {
+        }
+
+        /**
+         * @brief Constructs a factory-backed pool which shares its accounting (maxTotal, the outstanding count and the checked
+         *        out elements) with other pools (see sharded_resource_pool) so that an element created or checked out by one pool
+         *        may be checked into, evicted or discarded by another.
+         *
+         * @param options The factory and the limits
+         * @param ledger The accounting shared by the pools; must outlive the pool
+         */
+        resource_pool(resource_pool_options<T> options, resource_pool_ledger& ledger)
+            : _options(std::move(options))
+            , _ledger(&ledger)
+        {
+            if (_options.reapInterval.count() > 0) {
+                _reaper = std::make_unique<periodic_worker<>>(
+                        [this]() {
+                            evict();
+                            revalidate();
+                            prewarm();
+                        },
+                        std::chrono::duration_cast<std::chrono::microseconds>(_options.reapInterval),
+                        "resource_pool-reaper");
+            }
+        }
+
         ~resource_pool()
         {
+            _reaper.reset();
             clear();
         }
 
         void clear()
         {
-            if (std::lock_guard<std::recursive_mutex> l(_poolLock); !_pool.empty()) {
-                _pool.clear();
+            std::deque<envelope> doomed {};
+            if (std::lock_guard<std::mutex> l(_poolLock); !_pool.empty()) {
+                release(_pool.size());
+                doomed.swap(_pool);
+                idleChanged();
+            }
+        }
+
+        /// @brief Number of idle elements; read without the lock
+        auto size() const noexcept
+        {
+            return _idleCount.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Number of elements created by the factory which are alive (idle, checked out or being created)
+        size_t total() const noexcept
+        {
+            return _ledger->total.load();
+        }
+
+        /// @brief Snapshot of the counters; starts the next checkoutRate window
+        resource_pool_stats stats() const
+        {
+            std::lock_guard<std::mutex> l(_poolLock);
+            const auto                  now       = std::chrono::steady_clock::now();
+            const auto                  checkouts = _checkouts.load();
+            const auto                  window    = std::chrono::duration<double>(now - _rateSince).count();
+            const auto                  rate      = window > 0 ? static_cast<double>(checkouts - _rateCheckouts) / window : 0.0;
+            _rateSince                            = now;
+            _rateCheckouts                        = checkouts;
+            return {.checkouts        = checkouts,
+                    .checkins         = _checkins.load(),
+                    .checkoutRate     = rate,
+                    .emptyEvents      = _emptyEvents.load(),
+                    .outstanding      = _ledger->outstanding.load(),
+                    .peakOutstanding  = _ledger->peakOutstanding.load(),
+                    .waitTime         = _waitTimes.counts(),
+                    .heldTime         = _heldTimes.counts(),
+                    .idle             = _pool.size(),
+                    .total            = _ledger->total.load(),
+                    .evictedIdle      = _evictedIdle.load(),
+                    .evictedExpired   = _evictedExpired.load(),
+                    .failedValidation = _failedValidation.load()};
+        }
+
+        /**
+         * @brief Evicts the idle elements unused for longer than maxIdle (keeping minIdle of them) and the idle elements older
+         *        than maxLifetime. Invoked by the reaper; the evicted elements are destroyed outside of the lock.
+         *
+         * @return Number of elements evicted
+         */
+        size_t evict()
+        {
+            std::vector<T>              doomed {};
+            std::lock_guard<std::mutex> l(_poolLock);
+            const auto                  now = std::chrono::steady_clock::now();
+
+            if (_options.maxLifetime.count() > 0) {
+                for (auto it = _pool.begin(); it != _pool.end();) {
+                    if (now - it->createdAt > _options.maxLifetime) {
+                        doomed.push_back(std::move(it->item));
+                        it = _pool.erase(it);
+                        _evictedExpired++;
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+
+            if (_options.maxIdle.count() > 0) {
+                while ((_pool.size() > _options.minIdle) && (now - _pool.front().lastUsed > _options.maxIdle)) {
+                    doomed.push_back(std::move(_pool.front().item));
+                    _pool.pop_front();
+                    _evictedIdle++;
+                }
             }
+
+            release(doomed.size());
+            idleChanged();
+            if (!doomed.empty()) wakeCreator();
+            return doomed.size();
+        }
+
+        /// @brief Restart the peak outstanding tracking from the current value
+        void reset_peak() noexcept
+        {
+            _ledger->peakOutstanding = _ledger->outstanding.load();
         }
 
-        auto size()
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
         {
-            if (std::lock_guard<std::recursive_mutex> l(_poolLock); !_pool.empty()) {
-                return _pool.size();
+            return {{"_typver", "siddiqsoft.asynchrony-lib.resource_pool/0.10"}, {"stats", stats()}};
+        }
+#endif
+
+        /**
+         * @brief Validates the idle elements which have not been used (or validated) within validateAfterIdle; invoked by the
+         *        reaper so that the health checks happen off the checkout path.
+         *
+         * @return Number of elements rejected (and destroyed)
+         * @remarks The elements are taken out of the pool while they are validated; those which pass are returned to the front
+         *          (least recently used end) or handed to a waiting caller.
+         */
+        size_t revalidate()
+        {
+            if (!_options.validator) return 0;
+
+            std::deque<envelope> batch {};
+            {
+                std::lock_guard<std::mutex> l(_poolLock);
+                const auto                  now = std::chrono::steady_clock::now();
+                for (auto it = _pool.begin(); it != _pool.end();) {
+                    if (now - std::max(it->lastUsed, it->validatedAt) > _options.validateAfterIdle) {
+                        batch.push_back(std::move(*it));
+                        it = _pool.erase(it);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+                idleChanged();
+            }
+
+            std::vector<T>       doomed {};
+            std::deque<envelope> passed {};
+            for (auto& e : batch) {
+                bool healthy {false};
+                try {
+                    healthy = _options.validator(e.item);
+                }
+                catch (...) {
+                }
+                if (healthy) {
+                    e.validatedAt = std::chrono::steady_clock::now();
+                    passed.push_back(std::move(e));
+                }
+                else {
+                    doomed.push_back(std::move(e.item));
+                }
             }
 
-            return size_t(0);
+            std::lock_guard<std::mutex> l(_poolLock);
+            // Callers which parked while the batch was out get the elements first
+            while (!passed.empty() && !_waiters.empty()) {
+                auto w = _waiters.front();
+                _waiters.pop_front();
+                w->handoff.emplace(std::move(passed.front().item));
+                remember(*w->handoff, passed.front().createdAt);
+                passed.pop_front();
+                w->signal.notify_one();
+            }
+            _pool.insert(_pool.begin(), std::make_move_iterator(passed.begin()), std::make_move_iterator(passed.end()));
+            idleChanged();
+
+            _failedValidation += doomed.size();
+            release(doomed.size());
+            if (!doomed.empty()) wakeCreator();
+            return doomed.size();
         }
 
         [[nodiscard]] T checkout() /* throw() */
         {
-            if (std::lock_guard<std::recursive_mutex> l(_poolLock); !_pool.empty()) {
-                RunOnEnd roe([&]() { _pool.pop_front(); });
-                return std::move(_pool.front());
+            const auto                   started = std::chrono::steady_clock::now();
+            std::vector<T>               doomed {};
+            std::unique_lock<std::mutex> l(_poolLock);
+            if (auto item = obtain(l, doomed, std::chrono::steady_clock::time_point {}, false); item) {
+                handedOut(started);
+                return std::move(*item);
             }
 
             throw std::runtime_error("Empty pool; add something first!");
         }
 
+        /**
+         * @brief Checkout an element if one is available without blocking and without throwing
+         *
+         * @return The element or empty if the pool is empty
+         * @remarks Never invokes the factory (creating an element would block)
+         */
+        [[nodiscard]] std::optional<T> try_checkout()
+        {
+            const auto                   started = std::chrono::steady_clock::now();
+            std::vector<T>               doomed {};
+            std::unique_lock<std::mutex> l(_poolLock);
+            for (;;) {
+                bool stale {false};
+                auto item = takeIdle(doomed, stale);
+                if (!item) {
+                    _emptyEvents++;
+                    return item;
+                }
+                if (!stale || validate(l, doomed, *item)) {
+                    handedOut(started);
+                    return item;
+                }
+            }
+        }
+
+        /**
+         * @brief Checkout an element, waiting up to the timeout for one to be checked in (or created)
+         *
+         * @param timeout Maximum time to wait when the pool is empty
+         * @return The element or empty if the timeout expired
+         * @remarks Waiting callers are served in FIFO order: checkin() hands the element directly to the longest waiting caller
+         *          (it never goes through the pool) so a caller arriving later cannot barge ahead.
+         */
+        template <class Rep, class Period>
+        [[nodiscard]] std::optional<T> checkout_for(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            const auto                   started = std::chrono::steady_clock::now();
+            std::vector<T>               doomed {};
+            std::unique_lock<std::mutex> l(_poolLock);
+            auto                         item = obtain(l, doomed, deadline_after(started, timeout), true);
+            if (item) handedOut(started);
+            return item;
+        }
+
+        /**
+         * @brief Checkout an element wrapped in a lease which checks it back in on destruction
+         *
+         * @return lease holding the element
+         */
+        [[nodiscard]] lease<resource_pool> acquire() /* throw() */
+        {
+            return {*this, checkout()};
+        }
+
         /**
          * @brief Insert a new element or return a borrowed element
          *
@@ -108,10 +560,372 @@ namespace siddiqsoft
          */
         void checkin(T&& rsrc)
         {
-            if (std::lock_guard<std::recursive_mutex> l(_poolLock); true) {
-                _pool.push_back(std::move(rsrc));
+            restore(std::move(rsrc), true);
+        }
+
+        /**
+         * @brief Destroys a checked out element which must not return to the pool (for instance a broken connection) so the
+         *        factory may create a replacement.
+         *
+         * @param rsrc R-Value for the item previously checkout'd
+         */
+        void discard(T&& rsrc)
+        {
+            T                           doomed {std::move(rsrc)};
+            std::lock_guard<std::mutex> l(_poolLock);
+            if (forget(doomed) || !tracks(doomed)) handedBack();
+            release(1);
+            wakeCreator();
+        }
+
+        /**
+         * @brief Creates elements in parallel and adds them to the pool; use at startup to avoid paying for the creation on the
+         *        first requests.
+         *
+         * @param count Number of elements to create (limited by maxTotal)
+         * @return Number of elements created; factory failures are not counted
+         */
+        size_t prewarm(size_t count)
+        {
+            if (!_options.factory) return 0;
+
+            const size_t reserved = reserve(count);
+
+            std::atomic_size_t nextSlot {0}, created {0};
+            // Should a helper thread fail to start (std::system_error) before the calling thread joins in, return the room of
+            // the slots no creator claimed
+            RunOnEnd           onUnclaimed([&]() { release(reserved - std::min<size_t>(reserved, nextSlot.load())); });
+            auto               creator = [&]() {
+                while (nextSlot.fetch_add(1) < reserved) {
+                    try {
+                        restore(_options.factory(), false);
+                        created++;
+                    }
+                    catch (...) {
+                        release(1);
+                    }
+                }
+            };
+
+            // One creator per core (the calling thread participates)
+            {
+                const size_t              threads = std::min<size_t>(reserved, std::max(1u, std::thread::hardware_concurrency()));
+                std::vector<std::jthread> helpers {};
+                for (size_t i = 1; i < threads; i++) {
+                    helpers.emplace_back(creator);
+                }
+                creator();
+            }
+
+            return created.load();
+        }
+
+        /**
+         * @brief Tops up the idle elements to the configured minIdle
+         *
+         * @return Number of elements created
+         */
+        size_t prewarm()
+        {
+            const auto idle = size();
+            return prewarm(_options.minIdle > idle ? _options.minIdle - idle : 0);
+        }
+
+    private:
+        /**
+         * @brief Takes an idle element, creates one (single-flight) or waits
+         *
+         * @param l Holds _poolLock
+         * @param doomed Receives the expired elements; the caller destroys them after releasing the lock
+         * @param deadline When park is true the caller waits for a checkin until this time
+         * @param park When false the caller only waits for an in-progress creation (never for a checkin)
+         * @return The element or empty
+         */
+        std::optional<T> obtain(std::unique_lock<std::mutex>&          l,
+                                std::vector<T>&                        doomed,
+                                std::chrono::steady_clock::time_point deadline,
+                                bool                                   park)
+        {
+            // A waiter woken to create keeps its place at the front of the line
+            bool retried {false}, empty {false};
+            for (;;) {
+                bool stale {false};
+                if (auto item = takeIdle(doomed, stale); item) {
+                    if (!stale || validate(l, doomed, *item)) return item;
+                    // Rejected by the validator; try the next idle element
+                    continue;
+                }
+                if (!empty) {
+                    empty = true;
+                    _emptyEvents++;
+                }
+
+                if (canCreate() && (reserve(1) == 1)) return create(l);
+
+                if (!park) {
+                    if (!_creating) return std::nullopt;
+                    // Single-flight: wait for the in-progress creation and try again
+                    _created.wait(l, [this]() { return !_creating; });
+                    continue;
+                }
+
+                waiter w {};
+                if (retried)
+                    _waiters.push_front(&w);
+                else
+                    _waiters.push_back(&w);
+                w.signal.wait_until(l, deadline, [&w]() { return w.handoff.has_value() || w.retry; });
+                if (w.handoff) return std::move(w.handoff);
+                if (!w.retry) {
+                    // Timed out; neither checkin() nor a creator has claimed us so we are still in the list. Pass on the
+                    // opportunity to create if we were about to be offered it.
+                    std::erase(_waiters, &w);
+                    wakeCreator();
+                    return std::nullopt;
+                }
+                retried = true;
+            }
+        }
+
+        /// @brief Pools the element or hands it to a waiter
+        /// @param returned True for a checkin (counted in the stats); false for an element created by prewarm()
+        void restore(T&& rsrc, bool returned)
+        {
+            std::optional<T>            doomed {};
+            std::lock_guard<std::mutex> l(_poolLock);
+            const auto                  now       = std::chrono::steady_clock::now();
+            const auto                  recalled  = recall(rsrc, now);
+            const auto                  createdAt = recalled.value_or(now);
+
+            if (returned) {
+                _checkins++;
+                // When tracked, only an element which was checked out is a return (not a new element being added)
+                if (recalled || !tracks(rsrc)) handedBack();
+            }
+
+            if (isExpired(createdAt, now)) {
+                // Past its lifetime; destroyed (outside the lock) instead of pooled
+                doomed.emplace(std::move(rsrc));
+                _evictedExpired++;
+                release(1);
+                wakeCreator();
+            }
+            else if (_waiters.empty()) {
+                _pool.push_back({std::move(rsrc), createdAt, now});
+                idleChanged();
+            }
+            else {
+                // Hand off to the longest waiting caller. Notify while holding the lock since the waiter (and its condition
+                // variable) goes away as soon as it observes the handoff.
+                auto w = _waiters.front();
+                _waiters.pop_front();
+                w->handoff.emplace(std::move(rsrc));
+                remember(*w->handoff, createdAt);
+                w->signal.notify_one();
+            }
+        }
+
+        /// @brief Takes the least (fifo) or most (lifo) recently used idle element skipping (evicting) the expired elements;
+        ///        the lock must be held. The front of _pool stays the least recently used so evict() is the same for both.
+        /// @param doomed Receives the expired elements
+        /// @param stale Set when the element must be validated before it is handed out
+        std::optional<T> takeIdle(std::vector<T>& doomed, bool& stale)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            const bool lifo = _options.reuse == reuse_order::lifo;
+            while (!_pool.empty()) {
+                auto& e = lifo ? _pool.back() : _pool.front();
+                if (isExpired(e.createdAt, now)) {
+                    doomed.push_back(std::move(e.item));
+                    lifo ? _pool.pop_back() : _pool.pop_front();
+                    _evictedExpired++;
+                    release(1);
+                    continue;
+                }
+
+                stale = _options.validator && (now - std::max(e.lastUsed, e.validatedAt) > _options.validateAfterIdle);
+                std::optional<T> item {std::move(e.item)};
+                remember(*item, e.createdAt);
+                lifo ? _pool.pop_back() : _pool.pop_front();
+                idleChanged();
+                return item;
+            }
+            idleChanged();
+            return std::nullopt;
+        }
+
+        /// @brief Runs the validator outside of the lock; a rejected element is moved into doomed
+        /// @param l Holds _poolLock on entry and on return
+        /// @return True if the element passed
+        bool validate(std::unique_lock<std::mutex>& l, std::vector<T>& doomed, T& item)
+        {
+            l.unlock();
+            bool healthy {false};
+            try {
+                healthy = _options.validator(item);
+            }
+            catch (...) {
+            }
+            l.lock();
+
+            if (!healthy) {
+                forget(item);
+                doomed.push_back(std::move(item));
+                _failedValidation++;
+                release(1);
+                wakeCreator();
+            }
+            return healthy;
+        }
+
+        bool isExpired(std::chrono::steady_clock::time_point createdAt, std::chrono::steady_clock::time_point now) const noexcept
+        {
+            return (_options.maxLifetime.count() > 0) && (now - createdAt > _options.maxLifetime);
+        }
+
+        /// @brief The element's identity for the lifetime tracking; the pointee for pointer-like elements otherwise nullptr
+        /// (elements which are not pointer-like restart their lifetime whenever they are checked in)
+        static const void* identityOf(const T& item) noexcept
+        {
+            if constexpr (std::is_pointer_v<T>)
+                return item;
+            else if constexpr (requires { static_cast<const void*>(item.get()); })
+                return static_cast<const void*>(item.get());
+            else
+                return nullptr;
+        }
+
+        /// @brief True if the checked out element is recorded in the ledger
+        bool tracks(const T& item) const noexcept
+        {
+            return ((_options.maxLifetime.count() > 0) || _options.trackHeldTime) && (identityOf(item) != nullptr);
+        }
+
+        /// @brief Records the creation and checkout time of an element which is being checked out; the lock must be held
+        void remember(const T& item, std::chrono::steady_clock::time_point createdAt)
+        {
+            if (!tracks(item)) return;
+            std::lock_guard<std::mutex> l(_ledger->lock);
+            _ledger->checkedOut[identityOf(item)] = {createdAt, std::chrono::steady_clock::now()};
+        }
+
+        /// @brief Drops the record of a checked out element; the lock must be held
+        /// @return True if the element was checked out
+        bool forget(const T& item)
+        {
+            if (!tracks(item)) return false;
+            std::lock_guard<std::mutex> l(_ledger->lock);
+            return _ledger->checkedOut.erase(identityOf(item)) > 0;
+        }
+
+        /// @brief Drops the record of the element being checked in and records the time it was held; the lock must be held
+        /// @return The creation time of the element; empty for an element which was not checked out (or is not tracked)
+        std::optional<std::chrono::steady_clock::time_point> recall(const T& item, std::chrono::steady_clock::time_point now)
+        {
+            if (!tracks(item)) return std::nullopt;
+            std::lock_guard<std::mutex> l(_ledger->lock);
+            if (auto it = _ledger->checkedOut.find(identityOf(item)); it != _ledger->checkedOut.end()) {
+                const auto createdAt = it->second.createdAt;
+                _heldTimes.record(now - it->second.since);
+                _ledger->checkedOut.erase(it);
+                return createdAt;
+            }
+            return std::nullopt;
+        }
+
+        /// @brief Accounts for an element handed to a caller; the lock must be held
+        void handedOut(std::chrono::steady_clock::time_point started)
+        {
+            _checkouts++;
+            const auto outstanding = _ledger->outstanding.fetch_add(1) + 1;
+            auto       peak        = _ledger->peakOutstanding.load();
+            while ((peak < outstanding) && !_ledger->peakOutstanding.compare_exchange_weak(peak, outstanding)) {
+            }
+            _waitTimes.record(std::chrono::steady_clock::now() - started);
+        }
+
+        /// @brief Accounts for an element returned by a caller (never below zero)
+        void handedBack() noexcept
+        {
+            auto current = _ledger->outstanding.load();
+            while ((current > 0) && !_ledger->outstanding.compare_exchange_weak(current, current - 1)) {
             }
         }
+
+        /// @brief Publishes the idle count for size(); the lock must be held
+        void idleChanged() noexcept
+        {
+            _idleCount.store(_pool.size(), std::memory_order_relaxed);
+        }
+
+        /// @brief Must be invoked with the lock held
+        bool canCreate() const noexcept
+        {
+            return _options.factory && !_creating && (_ledger->total.load() < _options.maxTotal);
+        }
+
+        /// @brief Reserves room for up to count elements under maxTotal
+        /// @return Number of elements reserved
+        size_t reserve(size_t count) noexcept
+        {
+            auto current = _ledger->total.load();
+            for (;;) {
+                const auto n = std::min(count, _options.maxTotal - std::min(_options.maxTotal, current));
+                if (n == 0) return 0;
+                if (_ledger->total.compare_exchange_weak(current, current + n)) return n;
+            }
+        }
+
+        /// @brief Returns the room held by count elements which are gone (never below zero since checked in elements which
+        /// were not created by the factory are not counted)
+        void release(size_t count) noexcept
+        {
+            auto current = _ledger->total.load();
+            while (!_ledger->total.compare_exchange_weak(current, current - std::min(current, count))) {
+            }
+        }
+
+        /// @brief Invokes the factory outside of the lock (the room is already reserved); the lock is held on return
+        std::optional<T> create(std::unique_lock<std::mutex>& l)
+        {
+            _creating = true;
+            l.unlock();
+
+            std::optional<T> item {};
+            try {
+                item.emplace(_options.factory());
+            }
+            catch (...) {
+                l.lock();
+                release(1);
+                _creating = false;
+                _created.notify_all();
+                wakeCreator();
+                throw;
+            }
+
+            l.lock();
+            _creating = false;
+            _created.notify_all();
+            remember(*item, std::chrono::steady_clock::now());
+            // Let the next parked caller create its own element (if still allowed)
+            wakeCreator();
+            return item;
+        }
+
+        /// @brief Wakes the longest waiting caller so it may create an element; must be invoked with the lock held
+        void wakeCreator()
+        {
+            if (!_waiters.empty() && canCreate()) {
+                auto w = _waiters.front();
+                _waiters.pop_front();
+                w->retry = true;
+                w->signal.notify_one();
+            }
+        }
+
+        /// @brief The optional background reaper; declared last so that it is stopped before the other members are destroyed
+        std::unique_ptr<periodic_worker<>> _reaper {};
     };
 } // namespace siddiqsoft
 #endif
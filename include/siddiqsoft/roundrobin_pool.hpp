@@ -37,7 +37,15 @@
 #define ROUNDROBIN_POOL_HPP
 
 #include <concepts>
+#include <algorithm>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
 #include "simple_worker.hpp"
+#include "dispatch_policy.hpp"
+#include "striped_counter.hpp"
+#include "periodic_worker.hpp"
 
 
 namespace siddiqsoft
@@ -45,9 +53,11 @@ namespace siddiqsoft
     /// @brief Implements a lock-free round robin work allocation into vector of simple_worker<T>
     /// @tparam T Your datatype
     /// #tparam N Number of threads in the pool. Leave it to 0 to use the value returned by std::thread::hardware_concurrency()
+    /// @tparam DispatchPolicy Selects the worker for each item; see dispatch_policy.hpp. Defaults to the plain round robin.
     /// @remarks The number of threads in the pool is determined by the nature of your "work". If you're spending time against db
     /// then you might wish to use more threads as individual queries might take time and hog the thread.
-    template <typename T, uint16_t N = 0>
+    /// The pool may be resized at runtime via resize().
+    template <typename T, uint16_t N = 0, dispatch_policy DispatchPolicy = roundrobin_dispatch>
         requires std::is_move_constructible_v<T>
     struct roundrobin_pool
     {
@@ -61,18 +71,137 @@ namespace siddiqsoft
         /// @brief Consturcts a vector of simple_worker<T> with the given callback
         /// @param c Callback worker function
         roundrobin_pool(std::function<void(T&&)> c)
+            : callback(std::move(c))
         {
-            // *CRITICAL*
-            // This is step is *critical* otherwise we will end up moving threads as we add elements to the vector.
-            workers.reserve(N > 0 ? N : std::thread::hardware_concurrency());
-
             // Create as many threads as reported by the system..
-            for (unsigned i = 0; i < ((N > 0) ? N : std::thread::hardware_concurrency()); i++) {
-                workers.emplace_back(c);
+            resize(std::max<size_t>(1, (N > 0) ? N : std::thread::hardware_concurrency()));
+        }
+
+        /// @brief Adds or retires workers. Queued items are never dropped.
+        /// @param n The new number of active workers (at least one)
+        /// @remarks A retired worker hands its pinned items to the worker which now owns their key and the rest of its backlog, as
+        /// a single batch, to one of the surviving workers. Its thread is joined once the callback in progress (if any) returns.
+        /// When growing, the items queued for the keys which move to the new workers follow their key. The producers are held
+        /// back while the items move so the per-key order is preserved across the resize.
+        void resize(size_t n)
+        {
+            if (n == 0) throw std::out_of_range("roundrobin_pool::resize requires at least one worker");
+
+            std::lock_guard<std::mutex>                    myResizeLock(resize_mutex);
+            std::vector<std::unique_ptr<simple_worker<T>>> retired {};
+            {
+                // Waits for the producers already dispatching; the rest are held back until the workers are in place
+                std::unique_lock<striped_shared_mutex<>> myWriterLock(workers_mutex);
+                const size_t                             current = workers.size();
+
+                while (workers.size() < n) {
+                    workers.push_back(std::make_unique<simple_worker<T>>(callback));
+                }
+                // The jump consistent hash only moves keys from the existing workers onto the new ones
+                for (size_t i = 0; i < current && n > current; i++) {
+                    workers[i]->redistribute([&](bool pinned, uint64_t affinity) -> simple_worker<T>* {
+                        return pinned ? workers[keyWorkerIndex(affinity, n)].get() : nullptr;
+                    });
+                }
+
+                for (size_t i = n; i < current; i++) {
+                    workers[i]->redistribute([&](bool pinned, uint64_t affinity) {
+                        return pinned ? workers[keyWorkerIndex(affinity, n)].get() : workers[i % n].get();
+                    });
+                    retired.push_back(std::move(workers[i]));
+                }
+                if (n < current) workers.resize(n);
+
+                workersSize.store(n, std::memory_order_release);
             }
 
-            // Shortcut; save the size of the array
-            workersSize = workers.size();
+            if (retired.empty()) return;
+
+            // Join the retired threads outside of the lock so that their callbacks in progress may still queue into the pool
+            for (auto& w : retired) {
+                w->shutdown();
+            }
+            std::unique_lock<striped_shared_mutex<>> myWriterLock(workers_mutex);
+            for (const auto& w : retired) {
+                retiredServiceTimes += w->service_times();
+            }
+        }
+
+        /// @brief Starts the optional rebalancer. On every interval the idle workers steal from the tail of the busiest sibling's
+        /// deque and workers whose current callback has been running longer than the stall threshold are flagged (and their backlog
+        /// is handed to the idle workers first).
+        /// @param interval How often the rebalancer runs
+        /// @param stallThreshold A callback running longer than this marks its worker as stalled
+        /// @remarks Only unpinned items are moved; the items queued by key (and everything queued ahead of them) remain with their
+        /// worker so the per-key order is preserved. Invoke once after construction.
+        void enable_rebalancer(std::chrono::milliseconds interval, std::chrono::milliseconds stallThreshold)
+        {
+            stallLimit = stallThreshold;
+            rebalancer = std::make_unique<periodic_worker<>>([this]() { rebalance(); },
+                                                             std::chrono::duration_cast<std::chrono::microseconds>(interval),
+                                                             "roundrobin_pool-rebalancer");
+        }
+
+        /// @brief Performs a single rebalancing pass (this is what the rebalancer invokes on every interval)
+        /// @return Number of items moved
+        size_t rebalance()
+        {
+            // Skip the pass while a resize is migrating items
+            std::unique_lock<std::mutex> myResizeLock(resize_mutex, std::try_to_lock);
+            if (!myResizeLock.owns_lock()) return 0;
+
+            const size_t n = workersSize.load(std::memory_order_acquire);
+            if (n < 2) return 0;
+
+            std::vector<uint64_t> depth(n);
+            std::vector<bool>     isStalled(n);
+            size_t                stalled {0};
+            for (size_t i = 0; i < n; i++) {
+                depth[i]     = workers[i]->stats().depth;
+                isStalled[i] = (stallLimit.count() > 0) && (workers[i]->busy_for() > stallLimit);
+                if (isStalled[i]) stalled++;
+            }
+            stalledWorkers = stalled;
+
+            size_t moved {0};
+            for (size_t idle = 0; idle < n; idle++) {
+                if (isStalled[idle] || workers[idle]->load() > 0) continue;
+
+                // The donor is the stalled worker with the deepest backlog, otherwise the deepest worker
+                size_t donor = idle;
+                for (size_t i = 0; i < n; i++) {
+                    if (i == idle || depth[i] == 0) continue;
+                    if ((donor == idle) || (isStalled[i] && !isStalled[donor]) ||
+                        ((isStalled[i] == isStalled[donor]) && (depth[i] > depth[donor])))
+                        donor = i;
+                }
+                if (donor == idle) break;
+                // A healthy worker keeps half of its backlog; a stalled worker gives up everything it can
+                const uint64_t share = isStalled[donor] ? depth[donor] : depth[donor] / 2;
+                if (share == 0) continue;
+
+                const auto count = workers[donor]->steal_into(*workers[idle], share);
+                depth[donor] -= std::min<uint64_t>(depth[donor], count);
+                depth[idle] += count;
+                moved += count;
+            }
+
+            stolenCounter += moved;
+            return moved;
+        }
+
+        /// @brief Indices of the active workers whose current callback exceeds the stall threshold given to enable_rebalancer()
+        std::vector<size_t> stalled_workers() const
+        {
+            std::vector<size_t> result {};
+            if (stallLimit.count() == 0) return result;
+
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            const size_t                             n = workersSize.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; i++) {
+                if (workers[i]->busy_for() > stallLimit) result.push_back(i);
+            }
+            return result;
         }
 
         /// @brief Queue item into one of the thread's queue.
@@ -81,12 +210,109 @@ namespace siddiqsoft
         /// would be blocked. The cost of the % is cheaper than the cost it takes to pay for locks. The round-robin approach ensures
         /// that the underlying deque isn't being pop'd and push'd by multiple threads as there is only one consumer for that deque
         /// (one per thread) while we may have any number of producers.
+        /// Use a load-aware DispatchPolicy (such as power_of_two_dispatch) to route around a blocked worker.
         void queue(T&& item)
         {
-            // Increment counter *before* we invoke nextWorkerIndex..
-            ++queueCounter;
+            queueCounter.add();
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
             // Add into the thread's internal queue
-            workers.at(nextWorkerIndex()).queue(std::forward<T>(item));
+            workers[nextWorkerIndex()]->queue(std::forward<T>(item));
+        }
+
+        /// @brief Queue cancellable item into one of the thread's queue.
+        /// @param item The item must be std::move'd
+        /// @param token If a stop is requested before the item is dequeued then the item is skipped (the callback is not invoked)
+        void queue(T&& item, std::stop_token token)
+        {
+            queueCounter.add();
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            workers[nextWorkerIndex()]->queue(std::forward<T>(item), std::move(token));
+        }
+
+        /// @brief Queue item into the worker owning the key. All of the items for a given key are processed in order by the same
+        /// worker while different keys are processed in parallel.
+        /// @param key Any hashable key (account, session, ..)
+        /// @param item The item must be std::move'd
+        /// @param token Optional cancellation token
+        /// @remarks The key is mapped using a jump consistent hash so that a resize() moves only the keys which must move (about
+        /// 1/n of them when growing from n-1 to n workers). The items already queued for a moved key are migrated to its new
+        /// worker ahead of any item queued after the resize, so the items for a key are still started in the order queued. The
+        /// callback in progress on the key's old worker at the time of the resize may overlap with the next item on its new worker.
+        template <typename K>
+            requires(!std::same_as<std::remove_cvref_t<K>, std::stop_token>) && requires(const K& k) {
+                { std::hash<K> {}(k) } -> std::convertible_to<size_t>;
+            }
+        void queue(const K& key, T&& item, std::stop_token token = {})
+        {
+            queueCounter.add();
+            const uint64_t                           hash = std::hash<K> {}(key);
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            // Keyed items are pinned so the rebalancer never moves them away from their worker; the hash lets resize() find the
+            // key's new worker
+            workers[keyWorkerIndex(hash, workersSize.load(std::memory_order_acquire))]->queue(
+                    std::forward<T>(item), std::move(token), true, hash);
+        }
+
+        /// @brief Eagerly removes the cancelled items from all of the workers
+        /// @return Number of items removed
+        size_t purge_cancelled()
+        {
+            size_t                                   removed {0};
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            for (auto& w : workers) {
+                removed += w->purge_cancelled();
+            }
+            return removed;
+        }
+
+        /// @brief Snapshot of the queue gauges and counters for each of the active workers
+        /// @return One element per worker
+        std::vector<queue_stats> stats() const
+        {
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            const size_t                             n = workersSize.load(std::memory_order_acquire);
+            std::vector<queue_stats>                 result {};
+            result.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                result.push_back(workers[i]->stats());
+            }
+            return result;
+        }
+
+        /// @brief Load-imbalance coefficient across the active workers: max depth / mean depth.
+        /// @return 1.0 when perfectly balanced (or idle); N when a single one of the N workers holds the entire backlog
+        double imbalance() const
+        {
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            const size_t                             n = workersSize.load(std::memory_order_acquire);
+            uint64_t                                 total {0}, deepest {0};
+            for (size_t i = 0; i < n; i++) {
+                const auto d = workers[i]->stats().depth;
+                total += d;
+                deepest = std::max(deepest, d);
+            }
+            if (total == 0) return 1.0;
+            return static_cast<double>(deepest) * static_cast<double>(n) / static_cast<double>(total);
+        }
+
+        /// @brief Aggregate service time distribution across all of the workers (including the retired workers)
+        latency_counts service_times() const
+        {
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            latency_counts                           result {retiredServiceTimes};
+            for (const auto& w : workers) {
+                result += w->service_times();
+            }
+            return result;
+        }
+
+        /// @brief Restart the peak depth tracking for all of the workers
+        void reset_peak()
+        {
+            std::shared_lock<striped_shared_mutex<>> myReaderLock(workers_mutex);
+            for (auto& w : workers) {
+                w->reset_peak();
+            }
         }
 
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
@@ -96,33 +322,114 @@ namespace siddiqsoft
         nlohmann::json toJson() const
         {
             return {{"_typver", "siddiqsoft.asynchrony-lib.roundrobin_pool/0.10"},
-                    {"workersSize", workersSize},
-                    {"queueCounter", queueCounter.load()}};
+                    {"workersSize", workersSize.load()},
+                    {"dispatchPolicy", dispatchPolicyName()},
+                    {"queueCounter", queueCounter.load()},
+                    {"rebalancer", rebalancer != nullptr},
+                    {"stolenCounter", stolenCounter.load()},
+                    {"stalledWorkers", stalledWorkers.load()},
+                    {"imbalance", imbalance()},
+                    {"serviceTimeUs", service_times()},
+                    {"workers", stats()}};
         }
 #endif
 
 #ifdef _DEBUG
     public:
-        std::atomic_uint64_t queueCounter {0};
+        striped_counter<> queueCounter {};
 #else
     private:
-        std::atomic_uint64_t queueCounter {0};
+        /// @brief Total number of items queued; striped so the producers do not contend on one cache line
+        striped_counter<> queueCounter {};
 #endif
 
     private:
-        /// @brief Vector of the simple_worker elements of type T
-        std::vector<simple_worker<T>> workers {};
+        /// @brief The callback used by every worker (including those added by resize)
+        std::function<void(T&&)> callback;
+
+        /// @brief The active simple_worker elements of type T
+        std::vector<std::unique_ptr<simple_worker<T>>> workers {};
+
+        /// @brief Tracks the number of active workers (the size of the workers vector)
+        std::atomic_size_t workersSize {0};
+
+        /// @brief Held shared by the producers and readers of the workers vector and exclusively by resize(). Striped so that the
+        /// producers do not contend on one cache line.
+        mutable striped_shared_mutex<> workers_mutex {};
 
-        /// @brief Tracks the size of the array workers
-        uint64_t workersSize {};
+        /// @brief Serializes resize() and rebalance()
+        std::mutex resize_mutex {};
 
-        /// @brief Calculates the index into the workers thread using modulo and the running counter of the number of items pushed
-        /// into the queue.
+        /// @brief Service times recorded by the retired workers
+        latency_counts retiredServiceTimes {};
+
+        /// @brief Selects the worker for the next item
+        [[no_unique_address]] DispatchPolicy dispatchPolicy {};
+
+        /// @brief Running sequence handed to the DispatchPolicy; only touched by the policies which use it
+        std::atomic_uint64_t sequenceCounter {0};
+
+        /// @brief Callbacks running longer than this flag their worker as stalled (zero disables the detection)
+        std::chrono::milliseconds stallLimit {0};
+
+        /// @brief Number of items moved between workers by the rebalancer
+        std::atomic_uint64_t stolenCounter {0};
+
+        /// @brief Number of stalled workers detected on the last rebalancing pass
+        std::atomic_size_t stalledWorkers {0};
+
+        /// @brief The optional rebalancer; declared last so that it is stopped before the workers are destroyed
+        std::unique_ptr<periodic_worker<>> rebalancer {};
+
+        /// @brief Calculates the index into the workers array by delegating to the DispatchPolicy with the running sequence of the
+        /// dispatched items (unless the policy does not use it) and the per-worker load.
+        /// @return size_t index into the workers array
+        size_t nextWorkerIndex()
+        {
+            const auto n = workersSize.load(std::memory_order_acquire);
+            if (n <= 1) return 0;
+
+            // A single read-modify-write so that concurrent producers never observe the same sequence
+            uint64_t sequence {0};
+            if constexpr (dispatch_uses_sequence<DispatchPolicy>) sequence = sequenceCounter.fetch_add(1, std::memory_order_relaxed);
+
+            return dispatchPolicy.select(sequence, n, [this](size_t i) -> uint64_t { return workers[i]->load(); });
+        }
+
+        /// @brief The policy name for toJson (user-defined policies need not provide one)
+        static constexpr const char* dispatchPolicyName()
+        {
+            if constexpr (requires { DispatchPolicy::name; })
+                return DispatchPolicy::name;
+            else
+                return "custom";
+        }
+
+        /// @brief Maps the hash onto the workers using a jump consistent hash (Lamping & Veach)
+        /// @param hash The hash of the key
+        /// @param workerCount The number of workers to map onto
         /// @return size_t index into the workers array
-        constexpr size_t nextWorkerIndex()
+        static size_t keyWorkerIndex(uint64_t hash, size_t workerCount) noexcept
         {
-            return workersSize == 0 ? 0 : queueCounter.load() % workersSize;
+            const auto n = static_cast<int64_t>(workerCount);
+
+            // std::hash is the identity for integers on some platforms; mix the bits first (splitmix64 finalizer)
+            hash ^= hash >> 30;
+            hash *= 0xbf58476d1ce4e5b9ULL;
+            hash ^= hash >> 27;
+            hash *= 0x94d049bb133111ebULL;
+            hash ^= hash >> 31;
+
+            int64_t b {-1}, j {0};
+            while (j < n) {
+                b    = j;
+                hash = hash * 2862933555777941757ULL + 1;
+                j    = static_cast<int64_t>(static_cast<double>(b + 1) *
+                                         (static_cast<double>(1LL << 31) / static_cast<double>((hash >> 33) + 1)));
+            }
+            return static_cast<size_t>(std::max<int64_t>(b, 0));
         }
+
     };
 
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
@@ -130,8 +437,8 @@ namespace siddiqsoft
     /// @tparam T base typename
     /// @param dest destination json object
     /// @param src source object
-    template <typename T, uint16_t N = 0>
-    static void to_json(nlohmann::json& dest, const siddiqsoft::roundrobin_pool<T, N>& src)
+    template <typename T, uint16_t N = 0, typename P = roundrobin_dispatch>
+    static void to_json(nlohmann::json& dest, const siddiqsoft::roundrobin_pool<T, N, P>& src)
     {
         dest = src.toJson();
     }
@@ -0,0 +1,330 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef SHARDED_RESOURCE_POOL_HPP
+#define SHARDED_RESOURCE_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "resource_pool.hpp"
+
+namespace siddiqsoft
+{
+    /**
+     * @brief A resource_pool split into one shard per CPU so that the common path (checkout and checkin on the same core) only
+     *        touches the shard of the core the caller is running on instead of a single pool lock.
+     *        A checkout tries the local shard first and then the neighbouring shards before creating (or waiting).
+     *        The element is checked into the shard of the core the caller runs on at checkin.
+     * @tparam T The storage element type. Maybe shared_ptr or unique_ptr
+     * @remarks The shard is chosen with sched_getcpu() on Linux, GetCurrentProcessorNumber() on Windows and a hash of the
+     *          thread id elsewhere. Elements migrate between the shards with the threads so the shards share one
+     *          resource_pool_ledger: maxTotal and the outstanding count cover the whole pool (and maxLifetime follows an element
+     *          across the shards) while minIdle applies per shard.
+     */
+    template <typename T>
+        requires std::move_constructible<T>
+    class sharded_resource_pool
+    {
+    private:
+        /// @brief The accounting shared by the shards; declared before the shards which reference it
+        resource_pool_ledger                           _ledger {};
+        std::vector<std::unique_ptr<resource_pool<T>>> _shards {};
+        resource_pool_options<T>                       _options {};
+
+    public:
+        using value_type = T;
+
+        /**
+         * @brief Constructs a pool which only holds what is checked in
+         *
+         * @param shards Number of shards; zero for one per hardware thread
+         */
+        explicit sharded_resource_pool(size_t shards = 0)
+            : sharded_resource_pool(resource_pool_options<T> {}, shards)
+        {
+        }
+
+        /**
+         * @brief Constructs a factory-backed pool
+         *
+         * @param options The factory and the limits (maxTotal for the whole pool and minIdle for each shard). A single reaper
+         *                serves all of the shards.
+         * @param shards Number of shards; zero for one per hardware thread
+         */
+        explicit sharded_resource_pool(resource_pool_options<T> options, size_t shards = 0)
+            : _options(std::move(options))
+        {
+            if (shards == 0) shards = std::max(1u, std::thread::hardware_concurrency());
+
+            auto shardOptions         = _options;
+            shardOptions.reapInterval = std::chrono::milliseconds(0);
+            _shards.reserve(shards);
+            for (size_t i = 0; i < shards; i++) {
+                _shards.push_back(std::make_unique<resource_pool<T>>(shardOptions, _ledger));
+            }
+
+            if (_options.reapInterval.count() > 0) {
+                _reaper = std::make_unique<periodic_worker<>>(
+                        [this]() {
+                            for (auto& s : _shards) {
+                                s->evict();
+                                s->revalidate();
+                                s->prewarm();
+                            }
+                        },
+                        std::chrono::duration_cast<std::chrono::microseconds>(_options.reapInterval),
+                        "sharded_resource_pool-reaper");
+            }
+        }
+
+        sharded_resource_pool(sharded_resource_pool&)            = delete;
+        sharded_resource_pool(sharded_resource_pool&&)           = delete;
+        sharded_resource_pool& operator=(sharded_resource_pool&) = delete;
+        sharded_resource_pool& operator=(sharded_resource_pool&&) = delete;
+
+        ~sharded_resource_pool()
+        {
+            _reaper.reset();
+        }
+
+        /// @brief Number of shards
+        size_t shard_count() const noexcept
+        {
+            return _shards.size();
+        }
+
+        /// @brief The shard used by the calling thread for checkin and as the first choice for checkout
+        size_t current_shard() const noexcept
+        {
+#if defined(__linux__)
+            if (const auto cpu = sched_getcpu(); cpu >= 0) return static_cast<size_t>(cpu) % _shards.size();
+#elif defined(WIN64) || defined(_WIN64) || defined(WIN32) || defined(_WIN32)
+            return static_cast<size_t>(GetCurrentProcessorNumber()) % _shards.size();
+#endif
+            return std::hash<std::thread::id> {}(std::this_thread::get_id()) % _shards.size();
+        }
+
+        /// @brief Removes the idle elements from all of the shards
+        void clear()
+        {
+            for (auto& s : _shards) s->clear();
+        }
+
+        /// @brief Number of elements created by the factory which are alive (idle, checked out or being created)
+        size_t total() const noexcept
+        {
+            return _ledger.total.load();
+        }
+
+        /// @brief Number of idle elements across the shards; does not take any lock
+        auto size() const noexcept
+        {
+            size_t idle {0};
+            for (const auto& s : _shards) idle += s->size();
+            return idle;
+        }
+
+        [[nodiscard]] T checkout() /* throw() */
+        {
+            const auto home = current_shard();
+            if (auto item = scan(home); item) return std::move(*item);
+
+            // Every shard is empty; create in the local shard (throws if there is no factory or the shard is at its limit)
+            return _shards[home]->checkout();
+        }
+
+        /**
+         * @brief Checkout an element from the local or a neighbouring shard without blocking and without throwing
+         *
+         * @return The element or empty if every shard is empty
+         * @remarks Never invokes the factory (creating an element would block)
+         */
+        [[nodiscard]] std::optional<T> try_checkout()
+        {
+            return scan(current_shard());
+        }
+
+        /**
+         * @brief Checkout an element waiting up to the timeout for one to be created or checked in
+         *
+         * @param timeout Maximum time to wait
+         * @return The element or empty if the timeout expired
+         * @remarks The wait happens in the local shard in short slices between which the other shards are scanned again since
+         *          the element may be checked into any of the shards.
+         */
+        template <class Rep, class Period>
+        [[nodiscard]] std::optional<T> checkout_for(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            const auto deadline = deadline_after(std::chrono::steady_clock::now(), timeout);
+            for (;;) {
+                const auto home = current_shard();
+                if (auto item = scan(home); item) return item;
+
+                const auto remaining = deadline - std::chrono::steady_clock::now();
+                const auto slice     = std::min<std::chrono::steady_clock::duration>(remaining, std::chrono::milliseconds(1));
+                if (auto item = _shards[home]->checkout_for(std::max(slice, std::chrono::steady_clock::duration::zero())); item)
+                    return item;
+                if (std::chrono::steady_clock::now() >= deadline) return std::nullopt;
+            }
+        }
+
+        /**
+         * @brief Checkout an element wrapped in a lease which checks it back in on destruction
+         *
+         * @return lease holding the element
+         */
+        [[nodiscard]] lease<sharded_resource_pool> acquire() /* throw() */
+        {
+            return {*this, checkout()};
+        }
+
+        /**
+         * @brief Insert a new element or return a borrowed element into the shard of the calling thread's core. The element
+         *        may have been checked out of another shard; the shared ledger accounts for the return.
+         *
+         * @param rsrc R-Value for the item to return to the pool (previously checkout'd or create a new one!)
+         */
+        void checkin(T&& rsrc)
+        {
+            _shards[current_shard()]->checkin(std::move(rsrc));
+        }
+
+        /**
+         * @brief Destroys a checked out element which must not return to the pool so the factory may create a replacement.
+         *        Any shard may release it since the shards share the ledger.
+         *
+         * @param rsrc R-Value for the item previously checkout'd
+         */
+        void discard(T&& rsrc)
+        {
+            _shards[current_shard()]->discard(std::move(rsrc));
+        }
+
+        /**
+         * @brief Creates elements spread evenly across the shards
+         *
+         * @param count Number of elements to create
+         * @return Number of elements created
+         */
+        size_t prewarm(size_t count)
+        {
+            size_t created {0};
+            for (size_t i = 0; i < _shards.size(); i++) {
+                created += _shards[i]->prewarm(count / _shards.size() + (i < count % _shards.size() ? 1 : 0));
+            }
+            return created;
+        }
+
+        /**
+         * @brief Tops up every shard to the configured minIdle
+         *
+         * @return Number of elements created
+         */
+        size_t prewarm()
+        {
+            size_t created {0};
+            for (auto& s : _shards) created += s->prewarm();
+            return created;
+        }
+
+        /// @brief Sum of the shards' counters; the outstanding and total counts come from the shared ledger
+        resource_pool_stats stats() const
+        {
+            resource_pool_stats result {};
+            for (const auto& s : _shards) {
+                const auto st = s->stats();
+                result.checkouts += st.checkouts;
+                result.checkins += st.checkins;
+                result.checkoutRate += st.checkoutRate;
+                result.emptyEvents += st.emptyEvents;
+                result.waitTime += st.waitTime;
+                result.heldTime += st.heldTime;
+                result.idle += st.idle;
+                result.evictedIdle += st.evictedIdle;
+                result.evictedExpired += st.evictedExpired;
+                result.failedValidation += st.failedValidation;
+            }
+            result.outstanding     = _ledger.outstanding.load();
+            result.peakOutstanding = _ledger.peakOutstanding.load();
+            result.total           = _ledger.total.load();
+            return result;
+        }
+
+        /// @brief Restart the peak outstanding tracking from the current value
+        void reset_peak() noexcept
+        {
+            _ledger.peakOutstanding = _ledger.outstanding.load();
+        }
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            return {{"_typver", "siddiqsoft.asynchrony-lib.sharded_resource_pool/0.10"},
+                    {"shards", _shards.size()},
+                    {"stats", stats()}};
+        }
+#endif
+
+    private:
+        /// @brief Takes an idle element from the home shard or else from the nearest neighbour which has one
+        std::optional<T> scan(size_t home)
+        {
+            for (size_t i = 0; i < _shards.size(); i++) {
+                auto& s = _shards[(home + i) % _shards.size()];
+                // Skip the empty shards without touching their lock
+                if (s->size() == 0) continue;
+                if (auto item = s->try_checkout(); item) return item;
+            }
+            return std::nullopt;
+        }
+
+        /// @brief Declared last so it stops before the shards go away
+        std::unique_ptr<periodic_worker<>> _reaper {};
+    };
+} // namespace siddiqsoft
+#endif // !SHARDED_RESOURCE_POOL_HPP
@@ -37,8 +37,13 @@
 #define SIMPLE_POOL_HPP
 
 #include "simple_worker.hpp"
+#include "task_group.hpp"
 #include <optional>
 #include <latch>
+#include <limits>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 #include "siddiqsoft/RunOnEnd.hpp"
 
 namespace siddiqsoft
@@ -68,12 +73,18 @@ namespace siddiqsoft
             signalWaitInterval = std::chrono::milliseconds(0);
             // Compared to skipping the following code, we save at least about 100ms
             // of idle time waiting for the threads to be signalled by default.
+            std::lock_guard<std::mutex> myWorkersLock(workers_mutex);
             for (auto& t : workers) {
                 // Release the signal to indicate to the threads to abandon.
                 signal.release();
                 // Signal the threads to stop
                 if (t.request_stop() && t.joinable()) t.join();
             }
+
+            // Items abandoned in the deque must still be accounted for in their groups so no one waits forever.
+            for (auto& entry : items) {
+                if (entry.group != nullptr) entry.group->done();
+            }
         }
 
 
@@ -82,34 +93,44 @@ namespace siddiqsoft
         simple_pool(std::function<void(T&&)> c)
             : callback(std::move(c))
         {
-            // *CRITICAL*
-            // This is step is *critical* otherwise we will end up moving threads as we add elements to the vector.
-            workers.reserve((N > 0) ? N : std::thread::hardware_concurrency());
+            std::lock_guard<std::mutex> myWorkersLock(workers_mutex);
 
             // Create as many threads as reported by the system..
-            for (unsigned i = 0; i < ((N > 0) ? N : std::thread::hardware_concurrency()); i++) {
-                // Add the thread with the main driver
-                workers.emplace_back([&](std::stop_token st) {
-                    // The driver runs forever until signalled to stop
-                    // Tries to get next item ready in the queue (for max 1s cycle)
-                    // If we have an item, invoke the callback with the item
-                    while (!st.stop_requested()) {
-                        try {
-                            // The getNextItem performs the wait on the signal and if it expires, returns empty.
-                            // If there is an item, it will get that item (minimizing move) and performs the pop
-                            // and returns the item so we can invoke the callback outside the lock.
-                            if (auto item = getNextItem(signalWaitInterval); item.has_value() && !st.stop_requested()) {
-                                // Delegate to the callback outside the lock
-                                callback(std::move(*item));
-                            }
-                        }
-                        catch (...) {
-                        }
-                    } // while ..continue until we're asked to stop
-                });
-            }
+            addWorkers((N > 0) ? N : std::thread::hardware_concurrency());
         }
 
+        /// @brief Adds or retires threads in the pool. Queued items are never dropped; they remain in the shared deque for the
+        /// surviving threads.
+        /// @param n The new number of threads; must be at least 1
+        /// @remarks Retiring threads complete their current callback before exiting. The call blocks until the retired threads
+        /// have been joined which may take up to the signal wait interval.
+        void resize(size_t n)
+        {
+            if (n == 0) throw std::invalid_argument("simple_pool requires at least one thread");
+
+            std::vector<std::jthread> retiring {};
+            {
+                std::lock_guard<std::mutex> myWorkersLock(workers_mutex);
+
+                if (n > workers.size()) return addWorkers(n - workers.size());
+
+                retiring.insert(retiring.end(),
+                                std::make_move_iterator(workers.begin() + n),
+                                std::make_move_iterator(workers.end()));
+                workers.erase(workers.begin() + n, workers.end());
+                workersCount = workers.size();
+            }
+
+            // Ask the retiring threads to stop and wake them up; an item picked up by a retiring thread is returned to the
+            // front of the deque.
+            for (auto& t : retiring) {
+                t.request_stop();
+            }
+            signal.release(static_cast<std::ptrdiff_t>(retiring.size()));
+            for (auto& t : retiring) {
+                if (t.joinable()) t.join();
+            }
+        }
         /// @brief Queue item into the deque (takes "ownership" of the item)
         /// @param item Item to queue must be move'd
         void queue(T&& item)
@@ -118,9 +139,190 @@ namespace siddiqsoft
                 std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
 
                 items.emplace_back(std::forward<T>(item));
+                gauges.pushed();
+            }
+            signal.release();
+            ++queueCounter;
+            wakeHelpers();
+        }
+
+        /// @brief Queue cancellable item into the deque (takes "ownership" of the item)
+        /// @param item Item to queue must be move'd
+        /// @param token If a stop is requested before the item is dequeued then the item is skipped (the callback is not invoked)
+        void queue(T&& item, std::stop_token token)
+        {
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                items.emplace_back(std::forward<T>(item), nullptr, std::move(token));
+                gauges.pushed();
+            }
+            signal.release();
+            ++queueCounter;
+            wakeHelpers();
+        }
+
+        /// @brief Queue item as part of the given group (takes "ownership" of the item)
+        /// @param group The group is notified once the item has been processed; use group.wait() to wait for the batch
+        /// @param item Item to queue must be move'd
+        /// @param token Optional cancellation; a skipped item counts as complete within the group
+        void queue(task_group& group, T&& item, std::stop_token token = {})
+        {
+            group.add();
+            try {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                items.emplace_back(std::forward<T>(item), &group, std::move(token));
+                gauges.pushed();
+            }
+            catch (...) {
+                group.done();
+                throw;
             }
             signal.release();
             ++queueCounter;
+            wakeHelpers();
+        }
+
+        /// @brief Executes queued items inline on the calling thread ("help while waiting")
+        /// @param maxItems Maximum number of items to execute
+        /// @return Number of items executed; returns as soon as the deque is empty
+        /// @remarks Exceptions thrown by the callback are swallowed just as they are on the pool threads.
+        size_t run_pending(size_t maxItems = std::numeric_limits<size_t>::max())
+        {
+            size_t executed {0};
+
+            // Acquire the signal (without waiting) so the accounting for the pool threads remains accurate
+            while ((executed < maxItems) && signal.try_acquire()) {
+                if (auto entry = popNextItem(); entry.has_value()) {
+                    executed++;
+                    try {
+                        invoke(std::move(*entry));
+                    }
+                    catch (...) {
+                    }
+                }
+            }
+
+            return executed;
+        }
+
+        /// @brief Executes queued items inline on the calling thread until the deque is empty or the deadline expires
+        /// @param deadline No new items are started once the deadline has passed
+        /// @return Number of items executed
+        template <class Clock, class Duration>
+        size_t run_pending(const std::chrono::time_point<Clock, Duration>& deadline)
+        {
+            size_t executed {0};
+
+            while ((Clock::now() < deadline) && signal.try_acquire()) {
+                if (auto entry = popNextItem(); entry.has_value()) {
+                    executed++;
+                    try {
+                        invoke(std::move(*entry));
+                    }
+                    catch (...) {
+                    }
+                }
+            }
+
+            return executed;
+        }
+
+        /// @brief Waits for the group to complete while helping to execute the queued items on the calling thread.
+        /// @param group The group to wait upon
+        /// @remarks Safe to call from within a pool thread (for example to wait on sub-tasks) since the waiter drains the deque
+        /// rather than blocking one of the pool threads. When there is nothing to run the waiter blocks on the group until it
+        /// completes or queue() adds another item.
+        void wait(task_group& group)
+        {
+            helping(group);
+            RunOnEnd onExit([&]() { helped(group); });
+
+            while (!group.empty()) {
+                const auto seen = queueCounter.load();
+                if (run_pending(1) > 0) continue;
+                group.wait([&]() { return queueCounter.load() != seen; });
+            }
+        }
+
+        /// @brief Waits for the group to complete (or the timeout to expire) while helping to execute the queued items.
+        /// @param group The group to wait upon
+        /// @param timeout Maximum duration to wait
+        /// @return true if the group is complete; false on timeout
+        template <class Rep, class Period>
+        bool wait_for(task_group& group, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+            helping(group);
+            RunOnEnd onExit([&]() { helped(group); });
+
+            while (!group.empty()) {
+                const auto seen = queueCounter.load();
+                if (run_pending(deadline) > 0) continue;
+
+                if (std::chrono::steady_clock::now() >= deadline) return group.empty();
+                group.wait_until(deadline, [&]() { return queueCounter.load() != seen; });
+            }
+
+            return true;
+        }
+
+        /// @brief Eagerly removes the cancelled items from the deque
+        /// @return Number of items removed
+        /// @remarks Cancelled items are always skipped when they reach the front of the deque; use this method to release their
+        /// memory early when a large number of items have been cancelled.
+        size_t purge_cancelled()
+        {
+            std::deque<queued_item> removed {};
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                for (auto it = items.begin(); it != items.end();) {
+                    if (it->token.stop_requested()) {
+                        removed.emplace_back(std::move(*it));
+                        it = items.erase(it);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+                gauges.popped(removed.size());
+            }
+
+            // Outside the lock; consume the signals for the removed items so the workers do not wake up for them
+            for (size_t i = 0; i < removed.size(); i++) {
+                if (!signal.try_acquire()) break;
+            }
+            for (auto& entry : removed) {
+                if (entry.group != nullptr) entry.group->done();
+            }
+            gauges.skipped += removed.size();
+            return removed.size();
+        }
+
+        /// @brief Snapshot of the queue gauges and counters
+        queue_stats stats() const
+        {
+            std::chrono::microseconds oldest {0};
+            if (std::shared_lock<std::shared_mutex> myReaderLock(items_mutex); !items.empty()) {
+                oldest = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               items.front().queuedAt);
+            }
+            return gauges.snapshot(queueCounter.load(), oldest);
+        }
+
+        /// @brief Restart the peak depth tracking from the current depth
+        void reset_peak()
+        {
+            gauges.reset_peak();
+        }
+
+        /// @brief Number of threads servicing this pool
+        size_t threadCount() const
+        {
+            return workersCount.load();
         }
 
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
@@ -132,9 +334,11 @@ namespace siddiqsoft
         nlohmann::json toJson() const
         {
             return nlohmann::json {{"_typver", "siddiqsoft.asynchrony-lib.simple_pool/0.10"},
-                                   {"workersSize", workers.size()},
-                                   {"dequeSize", items.size()},
+                                   {"workersSize", workersCount.load()},
+                                   {"dequeSize", gauges.depth.load()},
                                    {"queueCounter", queueCounter.load()},
+                                   {"skippedCounter", gauges.skipped.load()},
+                                   {"stats", stats()},
                                    {"waitInterval", signalWaitInterval.count()}};
         }
 #endif
@@ -148,34 +352,175 @@ namespace siddiqsoft
 #endif
 
     private:
+        /// @brief Stored element in the deque; the item along with its (optional) group, cancellation token and the time it
+        /// was queued.
+        struct queued_item
+        {
+            queued_item(T&& i, task_group* g = nullptr, std::stop_token st = {})
+                : item(std::move(i))
+                , group(g)
+                , token(std::move(st))
+            {
+            }
+
+            T                                     item;
+            task_group*                           group {nullptr};
+            std::stop_token                       token {};
+            std::chrono::steady_clock::time_point queuedAt {std::chrono::steady_clock::now()};
+        };
+
+        /// @brief Depth, peak, processed, failed and skipped gauges
+        queue_gauges gauges {};
+
         std::vector<std::jthread> workers {};
+        /// @brief Guards the workers vector against concurrent resize
+        std::mutex                workers_mutex {};
+        /// @brief Number of threads in the workers vector (readable without the lock)
+        std::atomic_size_t        workersCount {0};
         std::function<void(T&&)>  callback;
         std::counting_semaphore<> signal {0};
-        std::deque<T>             items {};
-        std::shared_mutex         items_mutex;
+        std::deque<queued_item>   items {};
+        mutable std::shared_mutex items_mutex;
+        /// @brief The groups being waited upon by wait() and wait_for(); queue() wakes them up so they may help
+        std::vector<task_group*>  helpers {};
+        std::mutex                helpers_mutex {};
+        std::atomic_size_t        helpersCount {0};
         /// @brief This is the interval we wait on the signal. It starts off with 500ms and when the thread is to shutdown, it is
         /// set to 1ms.
         std::chrono::milliseconds signalWaitInterval {1500};
 
 
+        /// @brief Registers a thread waiting (and helping) on the group so that queue() wakes it up
+        void helping(task_group& group)
+        {
+            std::lock_guard<std::mutex> l(helpers_mutex);
+            helpers.push_back(&group);
+            helpersCount++;
+        }
+
+        /// @brief Removes the registration made by helping()
+        void helped(task_group& group)
+        {
+            std::lock_guard<std::mutex> l(helpers_mutex);
+            helpers.erase(std::find(helpers.begin(), helpers.end(), &group));
+            helpersCount--;
+        }
+
+        /// @brief Wakes the threads waiting in wait(task_group&) so they may run the item just queued
+        void wakeHelpers()
+        {
+            if (helpersCount.load() == 0) return;
+
+            std::lock_guard<std::mutex> l(helpers_mutex);
+            for (auto group : helpers) group->notify();
+        }
+
+        /// @brief Adds threads with the main driver. Must be called with the workers_mutex held.
+        /// @param count Number of threads to add
+        void addWorkers(size_t count)
+        {
+            workers.reserve(workers.size() + count);
+
+            for (size_t i = 0; i < count; i++) {
+                workers.emplace_back([this](std::stop_token st) {
+                    // The driver runs forever until signalled to stop
+                    // Tries to get next item ready in the queue (for max 1s cycle)
+                    // If we have an item, invoke the callback with the item
+                    while (!st.stop_requested()) {
+                        try {
+                            // The getNextItem performs the wait on the signal and if it expires, returns empty.
+                            // If there is an item, it will get that item (minimizing move) and performs the pop
+                            // and returns the item so we can invoke the callback outside the lock.
+                            if (auto entry = getNextItem(signalWaitInterval); entry.has_value()) {
+                                // Delegate to the callback outside the lock
+                                if (!st.stop_requested())
+                                    invoke(std::move(*entry));
+                                else
+                                    // We're retiring (or shutting down); hand the item back for the remaining threads
+                                    requeue(std::move(*entry));
+                            }
+                        }
+                        catch (...) {
+                        }
+                    } // while ..continue until we're asked to stop
+                });
+            }
+
+            workersCount = workers.size();
+        }
+
+        /// @brief Returns a dequeued item to the front of the deque
+        /// @param entry The item previously pulled via getNextItem
+        void requeue(queued_item&& entry)
+        {
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                items.emplace_front(std::move(entry));
+                gauges.pushed();
+            }
+            signal.release();
+        }
+
         /// @brief Performs an acquire on the semaphore and if successful,
         /// attempts to lock to pull the item from the top of the deque.
         /// @param delta Amount of milliseconds to wait on the semaphore
         /// @return An optional which may contain the item or empty (most of the time it'll be empty)
-        std::optional<T> getNextItem(std::chrono::milliseconds& delta)
-        {
-            if (signal.try_acquire_for(signalWaitInterval)) {
-                // Guard against empty signals which are terminating indicator
-                if (std::unique_lock<std::shared_mutex> myWriterLock(items_mutex); !items.empty()) {
-                    siddiqsoft::RunOnEnd onCleanup([&]() { items.pop_front(); });
-                    // WE require that the stored type by move-constructible!
-                    return std::move(items.front());
-                }
-            }
+        std::optional<queued_item> getNextItem(std::chrono::milliseconds& delta)
+        {
+            if (signal.try_acquire_for(signalWaitInterval)) return popNextItem();
 
             // Fall-through empty
             return {};
         }
+
+        /// @brief Locks and pulls the item from the top of the deque. The caller must have acquired the signal.
+        /// @return An optional which may contain the item or empty
+        std::optional<queued_item> popNextItem()
+        {
+            // Guard against empty signals which are terminating indicator
+            if (std::unique_lock<std::shared_mutex> myWriterLock(items_mutex); !items.empty()) {
+                siddiqsoft::RunOnEnd onCleanup([&]() {
+                    items.pop_front();
+                    gauges.popped();
+                });
+                // WE require that the stored type by move-constructible!
+                return std::move(items.front());
+            }
+
+            return {};
+        }
+
+        /// @brief Invokes the callback for the entry and completes the entry's group (even if the callback throws).
+        /// Cancelled entries are skipped.
+        /// @param entry The dequeued entry
+        void invoke(queued_item&& entry)
+        {
+            if (entry.group != nullptr) {
+                // Complete the group on scope exit; this also covers the skipped (cancelled) items
+                siddiqsoft::RunOnEnd onCompletion([group = entry.group]() { group->done(); });
+                entry.group = nullptr;
+                return invoke(std::move(entry));
+            }
+
+            // Cancelled items are skipped without invoking the callback
+            if (entry.token.stop_requested()) {
+                gauges.skipped++;
+                return;
+            }
+
+            const auto started = std::chrono::steady_clock::now();
+            try {
+                callback(std::move(entry.item));
+                gauges.processed++;
+            }
+            catch (...) {
+                gauges.failed++;
+                gauges.busy(std::chrono::steady_clock::now() - started);
+                throw;
+            }
+            gauges.busy(std::chrono::steady_clock::now() - started);
+        }
     };
 
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
@@ -45,8 +45,14 @@
 #include <deque>
 #include <semaphore>
 #include <stop_token>
+#include <optional>
+#include <limits>
+#include <vector>
+#include <algorithm>
 
 #include "siddiqsoft/RunOnEnd.hpp"
+#include "queue_stats.hpp"
+#include "latency_histogram.hpp"
 
 
 namespace siddiqsoft
@@ -64,6 +70,14 @@ namespace siddiqsoft
 
 
         ~simple_worker()
+        {
+            shutdown();
+        }
+
+
+        /// @brief Stops the processor thread once the callback in progress (if any) returns. The items still queued are not
+        /// processed. Invoked by the destructor.
+        void shutdown()
         {
             // This is critical step since we wait on the semaphore for a long time (keeps threads suspended) and if we do not
             // decrease this interval then the shutdown will be quite delayed.
@@ -106,11 +120,189 @@ namespace siddiqsoft
 
                 items.emplace_back(std::move(item));
                 queueCounter++;
+                gauges.pushed();
             }
             // Signal outside the lock and after adding the item.
             signal.release();
         }
 
+        /// @brief Queue cancellable item into this worker thread's deque
+        /// @param item This is move'd into the internal deque
+        /// @param token If a stop is requested before the item is dequeued then the item is skipped (the callback is not invoked)
+        /// @param pinned If true the item must be processed by this worker in order and may not be stolen via steal_into()
+        /// @param affinity Hash of the key a pinned item was queued for; handed to the selector given to redistribute()
+        void queue(T&& item, std::stop_token token, bool pinned = false, uint64_t affinity = 0)
+        {
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                items.emplace_back(std::move(item), std::move(token), pinned, affinity);
+                queueCounter++;
+                gauges.pushed();
+            }
+            // Signal outside the lock and after adding the item.
+            signal.release();
+        }
+
+        /// @brief Eagerly removes the cancelled items from the deque
+        /// @return Number of items removed
+        /// @remarks Cancelled items are always skipped when they reach the front of the deque; use this method to release their
+        /// memory early when a large number of items have been cancelled.
+        size_t purge_cancelled()
+        {
+            size_t removed {0};
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                removed = std::erase_if(items, [](const queued_item& entry) { return entry.token.stop_requested(); });
+                gauges.popped(removed);
+            }
+            // Consume the signals for the removed items so the processor does not wake up for them
+            for (size_t i = 0; i < removed; i++) {
+                if (!signal.try_acquire()) break;
+            }
+            gauges.skipped += removed;
+            return removed;
+        }
+
+        /// @brief Moves queued items (with their cancellation and timestamps) from the front of this worker's deque to the back of
+        /// the destination's deque
+        /// @param dest The destination worker
+        /// @param maxItems Maximum number of items to move
+        /// @return Number of items moved
+        size_t transfer_to(simple_worker& dest, size_t maxItems = std::numeric_limits<size_t>::max())
+        {
+            if (&dest == this || maxItems == 0) return 0;
+
+            std::deque<queued_item> moving {};
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                while (!items.empty() && moving.size() < maxItems) {
+                    moving.emplace_back(std::move(items.front()));
+                    items.pop_front();
+                }
+                gauges.popped(moving.size());
+            }
+            // Consume the signals for the moved items so the processor does not wake up for them
+            for (size_t i = 0; i < moving.size(); i++) {
+                if (!signal.try_acquire()) break;
+            }
+
+            const auto count = moving.size();
+            dest.append(std::move(moving));
+            return count;
+        }
+
+        /// @brief Moves unpinned items from the *back* of this worker's deque to the back of the destination's deque. Used by an idle
+        /// sibling to relieve a busy (or stalled) worker.
+        /// @param dest The destination worker
+        /// @param maxItems Maximum number of items to move
+        /// @return Number of items moved
+        /// @remarks Stops at the first pinned item from the back so the ordered items (and everything queued ahead of them) stay
+        /// with this worker.
+        size_t steal_into(simple_worker& dest, size_t maxItems)
+        {
+            if (&dest == this || maxItems == 0) return 0;
+
+            std::deque<queued_item> moving {};
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                while (!items.empty() && !items.back().pinned && moving.size() < maxItems) {
+                    moving.emplace_front(std::move(items.back()));
+                    items.pop_back();
+                }
+                gauges.popped(moving.size());
+            }
+            for (size_t i = 0; i < moving.size(); i++) {
+                if (!signal.try_acquire()) break;
+            }
+
+            const auto count = moving.size();
+            dest.append(std::move(moving));
+            return count;
+        }
+
+        /// @brief Moves queued items to the workers chosen by the selector. The items keep their relative order: each destination
+        /// receives its items, in the order they were queued here, at the back of its deque. Used when the owning pool is resized.
+        /// @param destinationOf Invoked under this worker's lock as destinationOf(pinned, affinity) for every queued item; returns
+        /// the destination worker or nullptr to keep the item here
+        /// @return Number of items moved
+        template <typename Selector>
+        size_t redistribute(Selector&& destinationOf)
+        {
+            std::vector<std::pair<simple_worker*, std::deque<queued_item>>> moving {};
+            size_t                                                          count {0};
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                std::deque<queued_item> keeping {};
+                for (auto& entry : items) {
+                    simple_worker* dest = destinationOf(entry.pinned, entry.affinity);
+                    if (dest == nullptr || dest == this) {
+                        keeping.emplace_back(std::move(entry));
+                        continue;
+                    }
+
+                    auto batch = std::ranges::find(moving, dest, &std::pair<simple_worker*, std::deque<queued_item>>::first);
+                    if (batch == moving.end()) batch = moving.emplace(moving.end(), dest, std::deque<queued_item> {});
+                    batch->second.emplace_back(std::move(entry));
+                    count++;
+                }
+                items.swap(keeping);
+                gauges.popped(count);
+            }
+            // Consume the signals for the moved items so the processor does not wake up for them
+            for (size_t i = 0; i < count; i++) {
+                if (!signal.try_acquire()) break;
+            }
+
+            for (auto& [dest, entries] : moving) {
+                dest->append(std::move(entries));
+            }
+            return count;
+        }
+
+        /// @brief How long the callback currently in progress has been running
+        /// @return Zero if the worker is not inside a callback
+        std::chrono::steady_clock::duration busy_for() const noexcept
+        {
+            const auto started = callbackStartedAt.load(std::memory_order_relaxed);
+            if (started == 0) return {};
+            return std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(started);
+        }
+
+        /// @brief Current load on this worker: the items waiting in the deque plus the callback in progress (if any)
+        /// @return Approximate load; read without any lock
+        uint64_t load() const noexcept
+        {
+            return gauges.depth.load(std::memory_order_relaxed) + outstandingCallback.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Snapshot of the queue gauges and counters
+        queue_stats stats() const
+        {
+            std::chrono::microseconds oldest {0};
+            if (std::shared_lock<std::shared_mutex> myReaderLock(items_mutex); !items.empty()) {
+                oldest = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               items.front().queuedAt);
+            }
+            return gauges.snapshot(queueCounter.load(), oldest);
+        }
+
+        /// @brief Restart the peak depth tracking from the current depth
+        void reset_peak()
+        {
+            gauges.reset_peak();
+        }
+
+        /// @brief Distribution of the time spent inside the callback (service time)
+        latency_counts service_times() const noexcept
+        {
+            return serviceTimes.counts();
+        }
+
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
         /// @brief Serializer for json
         /// @param  destination
@@ -120,9 +312,12 @@ namespace siddiqsoft
         nlohmann::json toJson() const
         {
             return {{"_typver", "siddiqsoft.asynchrony-lib.simple_worker/0.10"},
-                    {"dequeSize", items.size()},
+                    {"dequeSize", gauges.depth.load()},
                     //{"semaphoreMax", signal.max()}, // conflicts with windows headers :-(
-                    {"queueCounter", queueCounter},
+                    {"queueCounter", queueCounter.load()},
+                    {"skippedCounter", gauges.skipped.load()},
+                    {"stats", stats()},
+                    {"serviceTimeUs", service_times()},
                     {"threadPriority", Pri},
                     {"outstandingCallback", outstandingCallback.load()},
                     {"waitInterval", signalWaitInterval.count()}};
@@ -130,14 +325,39 @@ namespace siddiqsoft
 #endif
 
     private:
+        /// @brief Stored element in the deque; the item along with its (optional) cancellation token, the time it was queued and
+        /// whether it is pinned to this worker.
+        struct queued_item
+        {
+            queued_item(T&& i, std::stop_token st = {}, bool p = false, uint64_t a = 0)
+                : item(std::move(i))
+                , token(std::move(st))
+                , pinned(p)
+                , affinity(a)
+            {
+            }
+
+            T                                     item;
+            std::stop_token                       token {};
+            bool                                  pinned {false};
+            uint64_t                              affinity {0};
+            std::chrono::steady_clock::time_point queuedAt {std::chrono::steady_clock::now()};
+        };
+
         /// @brief Check the outstanding callback
         std::atomic_uint outstandingCallback {0};
+        /// @brief When the callback in progress started (steady_clock ticks); zero when idle
+        std::atomic<std::chrono::steady_clock::rep> callbackStartedAt {0};
         /// @brief Track number of times we've got items added into our queue
-        uint64_t queueCounter {0};
+        std::atomic_uint64_t queueCounter {0};
+        /// @brief Distribution of the time spent inside the callback
+        latency_histogram serviceTimes {};
+        /// @brief Depth, peak, processed, failed and skipped gauges
+        queue_gauges gauges {};
         /// @brief The internal queue for this worker.
-        std::deque<T> items {};
+        std::deque<queued_item> items {};
         /// @brief Mutex to protect the items
-        std::shared_mutex items_mutex {};
+        mutable std::shared_mutex items_mutex {};
         /// @brief Semaphore with default max signals.
         std::counting_semaphore<> signal {0};
         /// @brief This is the interval we wait on the signal. It starts off with 500ms and when the thread is to shutdown, it is
@@ -162,9 +382,13 @@ namespace siddiqsoft
                     // The getNextItem performs the wait on the signal and if it expires, returns empty.
                     // If there is an item, it will get that item (minimizing move) and performs the pop
                     // and returns the item so we can invoke the callback outside the lock.
-                    if (auto item = getNextItem(signalWaitInterval); item && !st.stop_requested()) {
-                        // Delegate to the callback outside the lock
-                        callback(std::move(*item));
+                    if (auto entry = getNextItem(signalWaitInterval); entry && !st.stop_requested()) {
+                        // Cancelled items are skipped without invoking the callback
+                        if (entry->token.stop_requested())
+                            gauges.skipped++;
+                        else
+                            // Delegate to the callback outside the lock
+                            invoke(std::move(entry->item));
                     }
                 }
                 catch (...) {
@@ -176,12 +400,15 @@ namespace siddiqsoft
         /// attempts to lock to pull the item from the top of the deque.
         /// @param delta Amount of milliseconds to wait on the semaphore
         /// @return An optional which may contain the item or empty (most of the time it'll be empty)
-        std::optional<T> getNextItem(std::chrono::milliseconds& delta)
+        std::optional<queued_item> getNextItem(std::chrono::milliseconds& delta)
         {
             if (signal.try_acquire_for(signalWaitInterval)) {
                 // Guard against empty signals which are terminating indicator
                 if (std::unique_lock<std::shared_mutex> myWriterLock(items_mutex); !items.empty()) {
-                    RunOnEnd onScopeExit([&]() { items.pop_front(); });
+                    RunOnEnd onScopeExit([&]() {
+                        items.pop_front();
+                        gauges.popped();
+                    });
                     // WE require that the stored type by move-constructible!
                     return std::move(items.front());
                     // The pop_front() happens on scope exit
@@ -194,6 +421,55 @@ namespace siddiqsoft
             // Fall-through empty
             return {};
         }
+
+        /// @brief Adds the items moved from a sibling to the back of the deque and signals the processor for them
+        /// @param moving The items in the order they are to be processed
+        void append(std::deque<queued_item>&& moving)
+        {
+            const auto count = moving.size();
+            if (count == 0) return;
+
+            {
+                std::unique_lock<std::shared_mutex> myWriterLock(items_mutex);
+
+                for (auto& entry : moving) {
+                    items.emplace_back(std::move(entry));
+                }
+                queueCounter += count;
+                gauges.pushed(count);
+            }
+            signal.release(static_cast<std::ptrdiff_t>(count));
+        }
+
+        /// @brief Invokes the callback and updates the processed/failed counters
+        /// @param item The item to deliver to the callback
+        void invoke(T&& item)
+        {
+            ++outstandingCallback;
+            const auto started = std::chrono::steady_clock::now();
+            callbackStartedAt.store(started.time_since_epoch().count(), std::memory_order_relaxed);
+            try {
+                callback(std::move(item));
+                gauges.processed++;
+            }
+            catch (...) {
+                gauges.failed++;
+                completed(started);
+                throw;
+            }
+            completed(started);
+        }
+
+        /// @brief Records the service time and clears the in-progress marker once the callback returns (or throws)
+        /// @param started When the callback was invoked
+        void completed(std::chrono::steady_clock::time_point started) noexcept
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - started;
+            gauges.busy(elapsed);
+            serviceTimes.record(elapsed);
+            callbackStartedAt.store(0, std::memory_order_relaxed);
+            --outstandingCallback;
+        }
     };
 
 #if defined(NLOHMANN_JSON_VERSION_MAJOR)
@@ -0,0 +1,171 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef STRIPED_COUNTER_HPP
+#define STRIPED_COUNTER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+
+namespace siddiqsoft
+{
+    namespace detail
+    {
+        /// @brief The calling thread's stripe; assigned round robin on the thread's first use
+        inline size_t stripe_of_this_thread() noexcept
+        {
+            static std::atomic_size_t nextThread {0};
+            thread_local const size_t index = nextThread.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+    } // namespace detail
+
+    /// @brief Counter split across cache-line sized stripes. Each thread increments its own stripe (assigned on first use) so
+    /// concurrent writers do not contend on a single cache line; the total is summed lazily by load().
+    /// @tparam Stripes Number of stripes; threads beyond this count share stripes
+    /// @remarks load() is not a point-in-time snapshot while writers are active but it never misses a completed add().
+    template <size_t Stripes = 16>
+        requires(Stripes > 0)
+    struct striped_counter
+    {
+        /// @brief Add to the calling thread's stripe
+        void add(uint64_t count = 1) noexcept
+        {
+            stripes[stripeIndex()].value.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /// @brief Sum of all of the stripes
+        uint64_t load() const noexcept
+        {
+            uint64_t total {0};
+            for (const auto& s : stripes) total += s.value.load(std::memory_order_relaxed);
+            return total;
+        }
+
+    private:
+        /// @brief Padded to a cache line so that neighbouring stripes do not share a line
+        struct alignas(64) stripe
+        {
+            std::atomic_uint64_t value {0};
+        };
+
+        std::array<stripe, Stripes> stripes {};
+
+        /// @brief The calling thread's stripe; assigned round robin on the thread's first use
+        static size_t stripeIndex() noexcept
+        {
+            return detail::stripe_of_this_thread() % Stripes;
+        }
+    };
+
+
+    /// @brief Reader/writer lock whose readers only touch the calling thread's stripe so that frequent, short readers (such as the
+    /// producers of a pool) do not contend on a single cache line. Writers are expected to be rare: they close the gate and wait
+    /// for the readers already inside to leave.
+    /// @tparam Stripes Number of stripes; threads beyond this count share stripes
+    /// @remarks Meets the requirements of std::shared_lock and std::unique_lock. Not recursive.
+    template <size_t Stripes = 16>
+        requires(Stripes > 0)
+    struct striped_shared_mutex
+    {
+        /// @brief Acquire shared ownership; blocks while a writer owns the lock
+        void lock_shared() noexcept
+        {
+            auto& readers = stripes[stripeIndex()].value;
+            while (true) {
+                // Announce the reader before checking for a writer; pairs with the writer closing the gate before counting
+                readers.fetch_add(1, std::memory_order_seq_cst);
+                if (!closed.load(std::memory_order_seq_cst)) return;
+                readers.fetch_sub(1, std::memory_order_seq_cst);
+                closed.wait(true, std::memory_order_acquire);
+            }
+        }
+
+        /// @brief Release shared ownership (must be invoked on the thread which acquired it)
+        void unlock_shared() noexcept
+        {
+            stripes[stripeIndex()].value.fetch_sub(1, std::memory_order_release);
+        }
+
+        /// @brief Acquire exclusive ownership; waits for the readers already inside to leave
+        void lock()
+        {
+            writer.lock();
+            closed.store(true, std::memory_order_seq_cst);
+            while (readers() > 0) std::this_thread::yield();
+        }
+
+        /// @brief Release exclusive ownership and wake the blocked readers
+        void unlock()
+        {
+            closed.store(false, std::memory_order_release);
+            closed.notify_all();
+            writer.unlock();
+        }
+
+    private:
+        /// @brief Padded to a cache line so that neighbouring stripes do not share a line
+        struct alignas(64) stripe
+        {
+            std::atomic_uint64_t value {0};
+        };
+
+        std::array<stripe, Stripes> stripes {};
+        /// @brief Set while a writer owns (or is acquiring) the lock
+        std::atomic_bool closed {false};
+        /// @brief Serializes the writers
+        std::mutex writer {};
+
+        /// @brief Number of readers inside
+        uint64_t readers() const noexcept
+        {
+            uint64_t total {0};
+            for (const auto& s : stripes) total += s.value.load(std::memory_order_seq_cst);
+            return total;
+        }
+
+        /// @brief The calling thread's stripe
+        static size_t stripeIndex() noexcept
+        {
+            return detail::stripe_of_this_thread() % Stripes;
+        }
+    };
+} // namespace siddiqsoft
+#endif // !STRIPED_COUNTER_HPP
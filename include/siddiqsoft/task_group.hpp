@@ -0,0 +1,156 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef TASK_GROUP_HPP
+#define TASK_GROUP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+
+namespace siddiqsoft
+{
+    /// @brief Tracks a batch of queued items so the producer may wait for the entire batch to be processed.
+    /// Every item queued through the group increments the pending counter and its completion (successful, failed via exception
+    /// or abandoned at pool shutdown) decrements it.
+    /// @remarks The group must outlive the items queued through it. Reuse is permitted once the group is empty.
+    class task_group
+    {
+    public:
+        task_group()                        = default;
+        task_group(task_group&)             = delete;
+        task_group& operator=(task_group&)  = delete;
+        task_group(task_group&&)            = delete;
+        task_group& operator=(task_group&&) = delete;
+
+        /// @brief Register one or more items with this group
+        /// @param count Number of items
+        void add(uint64_t count = 1) noexcept
+        {
+            pendingCounter.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /// @brief Mark one item as complete; wakes the waiters when the last item completes.
+        /// @remarks The last item is decremented and notified under the lock and the waiters take the lock before they observe
+        /// zero, so a waiter may destroy the group as soon as it returns without racing this method.
+        void done() noexcept
+        {
+            auto current = pendingCounter.load(std::memory_order_relaxed);
+            while (current > 1) {
+                if (pendingCounter.compare_exchange_weak(current, current - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                    return;
+            }
+
+            std::lock_guard<std::mutex> l(completion_mutex);
+            if (pendingCounter.fetch_sub(1, std::memory_order_acq_rel) == 1) completion.notify_all();
+        }
+
+        /// @brief Number of items which are yet to complete
+        uint64_t pending() const noexcept
+        {
+            return pendingCounter.load(std::memory_order_acquire);
+        }
+
+        /// @brief Check if all of the items have completed
+        /// @remarks Once the counter reads zero the lock is taken so that the last done() has released the group
+        bool empty() const noexcept
+        {
+            if (pending() != 0) return false;
+
+            std::lock_guard<std::mutex> l(completion_mutex);
+            return pending() == 0;
+        }
+
+        /// @brief Blocks until all of the items in the group have completed
+        void wait()
+        {
+            if (empty()) return;
+
+            std::unique_lock<std::mutex> l(completion_mutex);
+            completion.wait(l, [&]() { return pending() == 0; });
+        }
+
+        /// @brief Blocks until all of the items in the group have completed or the timeout expires
+        /// @param timeout Maximum duration to wait
+        /// @return true if the group is complete; false on timeout
+        template <class Rep, class Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if (empty()) return true;
+
+            std::unique_lock<std::mutex> l(completion_mutex);
+            return completion.wait_for(l, timeout, [&]() { return pending() == 0; });
+        }
+
+        /// @brief Blocks until all of the items have completed or the wakeup condition holds
+        /// @param wakeup Evaluated under the group's lock; re-evaluated whenever notify() is invoked
+        /// @return true if the group is complete
+        template <class Predicate>
+        bool wait(Predicate&& wakeup)
+        {
+            std::unique_lock<std::mutex> l(completion_mutex);
+            completion.wait(l, [&]() { return (pending() == 0) || wakeup(); });
+            return pending() == 0;
+        }
+
+        /// @brief Blocks until all of the items have completed, the wakeup condition holds or the deadline passes
+        /// @param deadline Time at which to give up
+        /// @param wakeup Evaluated under the group's lock; re-evaluated whenever notify() is invoked
+        /// @return true if the group is complete
+        template <class Clock, class Duration, class Predicate>
+        bool wait_until(const std::chrono::time_point<Clock, Duration>& deadline, Predicate&& wakeup)
+        {
+            std::unique_lock<std::mutex> l(completion_mutex);
+            completion.wait_until(l, deadline, [&]() { return (pending() == 0) || wakeup(); });
+            return pending() == 0;
+        }
+
+        /// @brief Wakes the waiters so they re-evaluate their wakeup condition
+        void notify() noexcept
+        {
+            std::lock_guard<std::mutex> l(completion_mutex);
+            completion.notify_all();
+        }
+
+    private:
+        std::atomic_uint64_t    pendingCounter {0};
+        mutable std::mutex      completion_mutex {};
+        std::condition_variable completion {};
+    };
+} // namespace siddiqsoft
+#endif // !TASK_GROUP_HPP
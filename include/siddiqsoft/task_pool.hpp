@@ -0,0 +1,296 @@
+/*
+    basic-pool : Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+       contributors may be used to endorse or promote products derived from
+       this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifndef TASK_POOL_HPP
+#define TASK_POOL_HPP
+
+#include <cstddef>
+#include <concepts>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "simple_pool.hpp"
+
+
+namespace siddiqsoft
+{
+    /// @brief Move-only, type-erased `void()` callable with inline (small-buffer) storage.
+    /// Callables whose size fits within Capacity bytes (and are nothrow move-constructible) are stored inline without any heap
+    /// allocation; larger callables are stored on the heap.
+    /// @tparam Capacity Number of bytes available for inline storage of the callable and its captures.
+    /// @remarks Unlike std::function the callable is not required to be copyable so you may capture unique_ptr and other
+    /// move-only types.
+    template <size_t Capacity = 48>
+    class basic_task
+    {
+    private:
+        /// @brief Operations table; one static instance per stored callable type.
+        struct operations
+        {
+            void (*invoke)(void*);
+            void (*relocate)(void* dest, void* src) noexcept;
+            void (*destroy)(void*) noexcept;
+            bool isInline;
+        };
+
+        template <typename F>
+        static constexpr bool fits_inline = (sizeof(F) <= Capacity) && (alignof(F) <= alignof(std::max_align_t)) &&
+                                            std::is_nothrow_move_constructible_v<F>;
+
+        template <typename F>
+        static constexpr operations inline_operations {
+                [](void* p) { (*static_cast<F*>(p))(); },
+                [](void* dest, void* src) noexcept {
+                    ::new (dest) F(std::move(*static_cast<F*>(src)));
+                    static_cast<F*>(src)->~F();
+                },
+                [](void* p) noexcept { static_cast<F*>(p)->~F(); },
+                true};
+
+        template <typename F>
+        static constexpr operations heap_operations {
+                [](void* p) { (**static_cast<F**>(p))(); },
+                [](void* dest, void* src) noexcept { *static_cast<F**>(dest) = *static_cast<F**>(src); },
+                [](void* p) noexcept { delete *static_cast<F**>(p); },
+                false};
+
+        alignas(std::max_align_t) std::byte storage[Capacity];
+        const operations*                   ops {nullptr};
+
+    public:
+        basic_task() noexcept = default;
+        basic_task(const basic_task&)            = delete;
+        basic_task& operator=(const basic_task&) = delete;
+
+        /// @brief Wraps the given callable
+        /// @param f Callable invocable as `void()`; it is moved (or copied) into the task.
+        template <typename F>
+            requires(!std::same_as<std::remove_cvref_t<F>, basic_task>) && std::invocable<std::decay_t<F>&> &&
+                    std::move_constructible<std::decay_t<F>>
+        basic_task(F&& f)
+        {
+            using Fn = std::decay_t<F>;
+
+            if constexpr (fits_inline<Fn>) {
+                ::new (static_cast<void*>(storage)) Fn(std::forward<F>(f));
+                ops = &inline_operations<Fn>;
+            }
+            else {
+                static_assert(sizeof(Fn*) <= Capacity, "Capacity must at least hold a pointer");
+                ::new (static_cast<void*>(storage)) Fn*(new Fn(std::forward<F>(f)));
+                ops = &heap_operations<Fn>;
+            }
+        }
+
+        /// @brief Move constructor; the source is left empty.
+        basic_task(basic_task&& src) noexcept
+        {
+            if (src.ops != nullptr) {
+                src.ops->relocate(storage, src.storage);
+                ops     = src.ops;
+                src.ops = nullptr;
+            }
+        }
+
+        basic_task& operator=(basic_task&& src) noexcept
+        {
+            if (this != &src) {
+                reset();
+                if (src.ops != nullptr) {
+                    src.ops->relocate(storage, src.storage);
+                    ops     = src.ops;
+                    src.ops = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        ~basic_task()
+        {
+            reset();
+        }
+
+        /// @brief Destroys the stored callable (if any) leaving this task empty.
+        void reset() noexcept
+        {
+            if (ops != nullptr) {
+                ops->destroy(storage);
+                ops = nullptr;
+            }
+        }
+
+        /// @brief Invokes the stored callable
+        /// @throws std::bad_function_call if the task is empty
+        void operator()()
+        {
+            if (ops == nullptr) throw std::bad_function_call();
+            ops->invoke(storage);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return ops != nullptr;
+        }
+
+        /// @brief Check if the callable is stored within the task (no heap allocation)
+        /// @return true if the callable is inline; false if empty or heap allocated
+        bool is_inline() const noexcept
+        {
+            return (ops != nullptr) && ops->isInline;
+        }
+    };
+
+    /// @brief The default task type; 48 bytes of inline storage makes the object exactly one cache line on 64-bit targets.
+    using task = basic_task<>;
+
+
+    /// @brief Implements a general purpose thread pool accepting any `void()` callable.
+    /// Rather than one pool (and its threads) per datatype, a single task_pool may be shared by unrelated producers.
+    /// @tparam N Number of threads in the pool. Leave it to 0 to use the value returned by std::thread::hardware_concurrency()
+    /// @remarks This is a thin wrapper over simple_pool<task, N> and shares its consumer loop, queue and shutdown semantics.
+    template <uint16_t N = 0>
+    struct task_pool
+    {
+        task_pool(task_pool&&)            = delete;
+        task_pool& operator=(task_pool&&) = delete;
+        task_pool(task_pool&)             = delete;
+        task_pool& operator=(task_pool&)  = delete;
+
+        task_pool() = default;
+
+        /// @brief Queue the callable for execution on one of the pool threads
+        /// @param f Callable invocable as `void()`; captures up to 48 bytes are stored without allocation
+        template <typename F>
+            requires std::invocable<std::decay_t<F>&> && std::move_constructible<std::decay_t<F>>
+        void queue(F&& f)
+        {
+            pool.queue(task {std::forward<F>(f)});
+        }
+
+        /// @brief Queue the callable as part of the given group
+        /// @param group The group is notified once the callable completes; use group.wait() to wait for the batch
+        /// @param f Callable invocable as `void()`
+        template <typename F>
+            requires std::invocable<std::decay_t<F>&> && std::move_constructible<std::decay_t<F>>
+        void queue(task_group& group, F&& f)
+        {
+            pool.queue(group, task {std::forward<F>(f)});
+        }
+
+        /// @brief Executes queued tasks inline on the calling thread
+        /// @param maxItems Maximum number of tasks to execute
+        /// @return Number of tasks executed
+        size_t run_pending(size_t maxItems = std::numeric_limits<size_t>::max())
+        {
+            return pool.run_pending(maxItems);
+        }
+
+        /// @brief Executes queued tasks inline on the calling thread until the deadline expires or the deque is empty
+        /// @param deadline No new tasks are started once the deadline has passed
+        /// @return Number of tasks executed
+        template <class Clock, class Duration>
+        size_t run_pending(const std::chrono::time_point<Clock, Duration>& deadline)
+        {
+            return pool.run_pending(deadline);
+        }
+
+        /// @brief Waits for the group to complete while helping to execute queued tasks
+        void wait(task_group& group)
+        {
+            pool.wait(group);
+        }
+
+        /// @brief Waits for the group to complete (or the timeout to expire) while helping to execute queued tasks
+        /// @return true if the group is complete; false on timeout
+        template <class Rep, class Period>
+        bool wait_for(task_group& group, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            return pool.wait_for(group, timeout);
+        }
+
+        /// @brief Adds or retires threads in the pool without dropping queued tasks
+        /// @param n The new number of threads; must be at least 1
+        void resize(size_t n)
+        {
+            pool.resize(n);
+        }
+
+        /// @brief Number of threads servicing this pool
+        size_t threadCount() const
+        {
+            return pool.threadCount();
+        }
+
+        /// @brief Snapshot of the queue gauges and counters
+        queue_stats stats() const
+        {
+            return pool.stats();
+        }
+
+        /// @brief Restart the peak depth tracking from the current depth
+        void reset_peak()
+        {
+            pool.reset_peak();
+        }
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+        /// @brief Serializer for json
+        nlohmann::json toJson() const
+        {
+            auto info       = pool.toJson();
+            info["_typver"] = "siddiqsoft.asynchrony-lib.task_pool/0.10";
+            return info;
+        }
+#endif
+
+    private:
+        simple_pool<task, N> pool {[](task&& t) { t(); }};
+    };
+
+#if defined(NLOHMANN_JSON_VERSION_MAJOR)
+    /// @brief Serializer for the task_pool
+    /// @param dest destination json object
+    /// @param src source object
+    template <uint16_t N = 0>
+    static void to_json(nlohmann::json& dest, const siddiqsoft::task_pool<N>& src)
+    {
+        dest = src.toJson();
+    }
+#endif
+
+} // namespace siddiqsoft
+#endif // !TASK_POOL_HPP
@@ -0,0 +1,135 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/fair_pool.hpp"
+
+
+struct tenant_item
+{
+    std::string tenant {};
+    uint32_t    i {0};
+};
+
+
+TEST(fair_pool, noisy_tenant_does_not_starve)
+{
+    std::atomic_bool         release {false};
+    std::mutex               order_mutex {};
+    std::vector<std::string> order {};
+
+    siddiqsoft::fair_pool<tenant_item, 1> workers {[&](auto&& item) {
+        if (item.tenant == "gate")
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> l(order_mutex);
+        order.push_back(item.tenant);
+    }};
+
+    // Park the only thread so we can build up the backlog
+    workers.queue("gate", {"gate", 0});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (uint32_t i = 0; i < 100; i++) {
+        workers.queue("noisy", {"noisy", i});
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        workers.queue("small", {"small", i});
+    }
+    EXPECT_EQ(100, workers.stats("noisy").depth);
+    EXPECT_EQ(3, workers.stats("small").depth);
+    EXPECT_EQ(0, workers.stats("unknown").queued);
+
+    release = true;
+    for (int i = 0; i < 100; i++) {
+        if (std::lock_guard<std::mutex> l(order_mutex); order.size() == 104) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::lock_guard<std::mutex> l(order_mutex);
+    ASSERT_EQ(104, order.size());
+    // The small tenant is served alternately with the noisy one rather than after it: all of its items are done within the
+    // first few positions after the gate.
+    auto lastSmall = std::find(order.rbegin(), order.rend(), "small");
+    EXPECT_LE(std::distance(lastSmall, order.rend()), 8);
+    EXPECT_EQ(100, workers.stats("noisy").processed);
+    EXPECT_EQ(0, workers.stats("noisy").depth);
+    EXPECT_EQ(100, workers.stats("noisy").peakDepth);
+}
+
+
+TEST(fair_pool, weights)
+{
+    std::atomic_bool         release {false};
+    std::mutex               order_mutex {};
+    std::vector<std::string> order {};
+
+    siddiqsoft::fair_pool<tenant_item, 1> workers {[&](auto&& item) {
+        if (item.tenant == "gate")
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> l(order_mutex);
+        order.push_back(item.tenant);
+    }};
+
+    workers.set_weight("heavy", 3);
+    workers.queue("gate", {"gate", 0});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (uint32_t i = 0; i < 30; i++) {
+        workers.queue("light", {"light", i});
+        workers.queue("heavy", {"heavy", i});
+    }
+
+    release = true;
+    for (int i = 0; i < 100; i++) {
+        if (std::lock_guard<std::mutex> l(order_mutex); order.size() == 61) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::lock_guard<std::mutex> l(order_mutex);
+    ASSERT_EQ(61, order.size());
+    // Within the first 20 items after the gate the heavy tenant receives three items for every light one
+    auto heavy = std::count(order.begin() + 1, order.begin() + 21, "heavy");
+    EXPECT_EQ(15, heavy);
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
@@ -0,0 +1,144 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <format>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/lockfree_resource_pool.hpp"
+
+
+TEST(lockfree_resource_pool, T_unique_ptr_string)
+{
+    siddiqsoft::lockfree_resource_pool<std::unique_ptr<std::string>> rp {4};
+
+    EXPECT_EQ(4, rp.capacity());
+    EXPECT_EQ(0, rp.size());
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+
+    rp.checkin(std::make_unique<std::string>(__TIME__));
+    EXPECT_EQ(1, rp.size());
+
+    auto item = rp.checkout();
+    EXPECT_EQ(0, rp.size());
+    EXPECT_EQ(__TIME__, *item);
+    item->append("-ok");
+
+    rp.checkin(std::move(item));
+    EXPECT_EQ(1, rp.size());
+
+    auto item2 = rp.checkout();
+    EXPECT_TRUE(item2->ends_with("-ok"));
+    rp.checkin(std::move(item2));
+}
+
+
+TEST(lockfree_resource_pool, T_overflow)
+{
+    siddiqsoft::lockfree_resource_pool<std::shared_ptr<int>> rp {3};
+
+    // Rounded up to a power of two
+    EXPECT_EQ(4, rp.capacity());
+    for (int i = 0; i < 4; i++) {
+        rp.checkin(std::make_shared<int>(i));
+    }
+
+    // The argument is left untouched when the pool is full
+    auto extra = std::make_shared<int>(99);
+    EXPECT_THROW(rp.checkin(std::move(extra)), std::overflow_error);
+    EXPECT_TRUE(extra);
+
+    // FIFO order, same as resource_pool
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(i, *rp.checkout());
+    }
+    EXPECT_EQ(0, rp.size());
+}
+
+
+TEST(lockfree_resource_pool, T_concurrent)
+{
+    siddiqsoft::lockfree_resource_pool<std::unique_ptr<uint64_t>> rp {16};
+    for (int i = 0; i < 8; i++) {
+        rp.checkin(std::make_unique<uint64_t>(0));
+    }
+
+    std::atomic_uint64_t      misses {0};
+    std::vector<std::jthread> threads {};
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 20000; i++) {
+                try {
+                    auto item = rp.checkout();
+                    (*item)++;
+                    rp.checkin(std::move(item));
+                }
+                catch (const std::runtime_error&) {
+                    misses++;
+                }
+            }
+        });
+    }
+    threads.clear();
+
+    // Nothing was lost or duplicated
+    EXPECT_EQ(8, rp.size());
+    uint64_t total {0};
+    while (rp.size() > 0) {
+        total += *rp.checkout();
+    }
+    EXPECT_EQ(8 * 20000 - misses.load(), total);
+    std::cerr << std::format("{} - misses:{}\n", __func__, misses.load());
+}
+
+
+TEST(lockfree_resource_pool, T_lease)
+{
+    siddiqsoft::lockfree_resource_pool<std::unique_ptr<std::string>> rp {2};
+    rp.checkin(std::make_unique<std::string>(__TIME__));
+    {
+        auto item = rp.acquire();
+        EXPECT_EQ(0, rp.size());
+        EXPECT_EQ(__TIME__, *item.get());
+    }
+    EXPECT_EQ(1, rp.size());
+}
@@ -0,0 +1,122 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <format>
+#include <memory>
+#include <string>
+#include <thread>
+
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/magazine_pool.hpp"
+
+
+TEST(magazine_pool, T_unique_ptr_string)
+{
+    siddiqsoft::magazine_pool<std::unique_ptr<std::string>, 4> rp {};
+
+    EXPECT_EQ(0, rp.size());
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+
+    rp.checkin(std::make_unique<std::string>(__TIME__));
+    EXPECT_EQ(1, rp.size());
+
+    auto item = rp.checkout();
+    EXPECT_EQ(0, rp.size());
+    EXPECT_EQ(__TIME__, *item);
+    item->append("-ok");
+    rp.checkin(std::move(item));
+
+    auto item2 = rp.checkout();
+    EXPECT_TRUE(item2->ends_with("-ok"));
+    rp.checkin(std::move(item2));
+}
+
+
+TEST(magazine_pool, T_spill_and_thread_exit)
+{
+    siddiqsoft::magazine_pool<std::shared_ptr<int>, 4> rp {};
+
+    // The calling thread's magazine overflows into the depot
+    for (int i = 0; i < 10; i++) {
+        rp.checkin(std::make_shared<int>(i));
+    }
+    EXPECT_EQ(10, rp.size());
+
+    // Another thread sees only the depot; its own magazine is returned when it exits
+    std::jthread([&]() {
+        EXPECT_EQ(6, rp.size());
+        auto a = rp.checkout();
+        auto b = rp.checkout();
+        EXPECT_EQ(4, rp.size());
+        rp.checkin(std::move(a));
+        rp.checkin(std::move(b));
+        EXPECT_EQ(6, rp.size());
+    }).join();
+    EXPECT_EQ(10, rp.size());
+
+    rp.flush();
+    EXPECT_EQ(10, rp.size());
+    int total {0};
+    for (int i = 0; i < 10; i++) {
+        total += *rp.checkout();
+    }
+    EXPECT_EQ(45, total);
+}
+
+
+TEST(magazine_pool, T_pool_destroyed_first)
+{
+    auto             tracker = std::make_shared<int>(42);
+    std::atomic_bool checkedIn {false}, poolGone {false};
+    std::jthread     holder {};
+    {
+        siddiqsoft::magazine_pool<std::shared_ptr<int>> rp {};
+        holder = std::jthread([&]() {
+            rp.checkin(std::shared_ptr<int>(tracker));
+            checkedIn = true;
+            while (!poolGone) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+        while (!checkedIn) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_EQ(2, tracker.use_count());
+    }
+    poolGone = true;
+    holder.join();
+    // The element cached by the thread was destroyed when the thread exited
+    EXPECT_EQ(1, tracker.use_count());
+}
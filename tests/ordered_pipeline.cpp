@@ -0,0 +1,133 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/ordered_pipeline.hpp"
+
+
+TEST(ordered_pipeline, in_order)
+{
+    std::vector<uint32_t>                                results {};
+    siddiqsoft::ordered_pipeline<uint32_t, uint32_t, 4> pipeline {[](uint32_t&& i) {
+                                                                      // Earlier items take longer so they complete out of order
+                                                                      std::this_thread::sleep_for(std::chrono::microseconds((i % 7) * 300));
+                                                                      return i * 2;
+                                                                  },
+                                                                  [&](uint32_t&& r) { results.push_back(r); },
+                                                                  16};
+
+    for (uint32_t i = 0; i < 200; i++) {
+        pipeline.queue(std::move(i));
+        // The reorder window bounds the number of items in flight
+        EXPECT_LE(pipeline.pending(), 16);
+    }
+    for (int i = 0; i < 200 && pipeline.pending() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(200, pipeline.delivered());
+    ASSERT_EQ(200, results.size());
+    for (uint32_t i = 0; i < 200; i++) {
+        EXPECT_EQ(i * 2, results[i]);
+    }
+    std::cerr << nlohmann::json(pipeline).dump() << std::endl;
+}
+
+
+TEST(ordered_pipeline, skips_failures)
+{
+    std::vector<uint32_t>                                results {};
+    siddiqsoft::ordered_pipeline<uint32_t, uint32_t, 4> pipeline {[](uint32_t&& i) {
+                                                                      if (i % 10 == 3) throw std::runtime_error("bad item");
+                                                                      return i;
+                                                                  },
+                                                                  [&](uint32_t&& r) { results.push_back(r); },
+                                                                  8};
+
+    for (uint32_t i = 0; i < 100; i++) {
+        pipeline.queue(std::move(i));
+    }
+    for (int i = 0; i < 200 && pipeline.pending() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // The failed items do not hold up the remaining results
+    EXPECT_EQ(90, pipeline.delivered());
+    EXPECT_EQ(90, results.size());
+    EXPECT_TRUE(std::ranges::is_sorted(results));
+    EXPECT_EQ(10, pipeline.toJson().value("failedCounter", 0));
+}
+
+
+TEST(ordered_pipeline, queue_from_output)
+{
+    // The output callback queues follow-up items while the window is full; it must not wait on itself
+    std::vector<uint32_t>                                results {};
+    siddiqsoft::ordered_pipeline<uint32_t, uint32_t, 4>* self {nullptr};
+    siddiqsoft::ordered_pipeline<uint32_t, uint32_t, 4>  pipeline {[](uint32_t&& i) { return i; },
+                                                                  [&](uint32_t&& r) {
+                                                                      results.push_back(r);
+                                                                      if (r < 100) {
+                                                                          self->queue(r + 100);
+                                                                          self->queue(r + 200);
+                                                                      }
+                                                                  },
+                                                                  2};
+    self = &pipeline;
+
+    for (uint32_t i = 0; i < 20; i++) {
+        pipeline.queue(std::move(i));
+    }
+    for (int i = 0; i < 500 && pipeline.pending() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(0, pipeline.pending());
+    EXPECT_EQ(60, pipeline.delivered());
+    ASSERT_EQ(60, results.size());
+    // The producer's items keep their order
+    std::vector<uint32_t> originals {};
+    std::copy_if(results.begin(), results.end(), std::back_inserter(originals), [](auto r) { return r < 100; });
+    EXPECT_TRUE(std::is_sorted(originals.begin(), originals.end()));
+    EXPECT_EQ(20, originals.size());
+}
@@ -0,0 +1,124 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <format>
+#include <string>
+#include <thread>
+#include <numeric>
+#include <vector>
+
+#include "../include/siddiqsoft/parallel.hpp"
+
+
+TEST(parallel, parallel_for)
+{
+    siddiqsoft::task_pool<4> pool {};
+    std::vector<int>         data(10000, 1);
+
+    siddiqsoft::parallel_for(pool, data, 128, [](int& v) { v *= 2; });
+
+    EXPECT_EQ(20000, std::accumulate(data.begin(), data.end(), 0));
+}
+
+
+TEST(parallel, parallel_transform)
+{
+    siddiqsoft::task_pool<4> pool {};
+    std::vector<int>         data(5000);
+    std::iota(data.begin(), data.end(), 0);
+    std::vector<std::string> out(data.size());
+
+    auto last = siddiqsoft::parallel_transform(pool, data, out.begin(), 100, [](int v) { return std::to_string(v); });
+
+    EXPECT_EQ(out.end(), last);
+    for (size_t i = 0; i < data.size(); i++) {
+        EXPECT_EQ(std::to_string(i), out[i]);
+    }
+}
+
+
+TEST(parallel, parallel_reduce)
+{
+    siddiqsoft::task_pool<4> pool {};
+    std::vector<uint64_t>    data(100001);
+    std::iota(data.begin(), data.end(), uint64_t(0));
+
+    auto sum = siddiqsoft::parallel_reduce(pool, data, 1000, uint64_t(7), [](uint64_t a, uint64_t b) { return a + b; });
+    EXPECT_EQ(uint64_t(7) + (uint64_t(100000) * uint64_t(100001)) / 2, sum);
+
+    // Empty range returns init
+    std::vector<uint64_t> empty {};
+    EXPECT_EQ(42, siddiqsoft::parallel_reduce(pool, empty, 10, uint64_t(42), std::plus<uint64_t> {}));
+}
+
+
+TEST(parallel, exception_propagates)
+{
+    siddiqsoft::task_pool<2> pool {};
+    std::vector<int>         data(1000, 0);
+
+    EXPECT_THROW(siddiqsoft::parallel_for(pool, data, 10,
+                                          [](int& v) {
+                                              if (v == 0) throw std::runtime_error("chunk failed");
+                                          }),
+                 std::runtime_error);
+
+    // The pool remains usable
+    siddiqsoft::parallel_for(pool, data, 10, [](int& v) { v = 1; });
+    EXPECT_EQ(1000, std::accumulate(data.begin(), data.end(), 0));
+}
+
+
+TEST(parallel, nested)
+{
+    // Every pool thread runs an outer task which in turn waits on an inner parallel_for; the waiters must help drain the pool
+    // otherwise this would deadlock.
+    siddiqsoft::task_pool<2> pool {};
+    siddiqsoft::task_group   batch {};
+    std::atomic_uint         total {0};
+
+    for (int outer = 0; outer < 4; outer++) {
+        pool.queue(batch, [&pool, &total]() {
+            std::vector<int> data(1000, 1);
+            siddiqsoft::parallel_for(pool, data, 10, [&total](int& v) { total += v; });
+        });
+    }
+
+    EXPECT_TRUE(pool.wait_for(batch, std::chrono::seconds(10)));
+    EXPECT_EQ(4000, total.load());
+}
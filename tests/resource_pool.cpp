@@ -35,10 +35,14 @@
 
 #include "gtest/gtest.h"
 
+#include <atomic>
 #include <iostream>
 #include <format>
 #include <string>
 #include <thread>
+#include <mutex>
+#include <set>
+#include <vector>
 
 
 #include "nlohmann/json.hpp"
@@ -183,3 +187,511 @@ TEST(resource_pool, T_checkin_checkout_vector_string)
 
     EXPECT_TRUE(passTest);
 }
+
+
+TEST(resource_pool, T_lease)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<std::string>> rp {};
+    rp.checkin(std::make_unique<std::string>(__TIME__));
+
+    // No larger than the pool pointer plus the handle
+    static_assert(sizeof(siddiqsoft::lease<decltype(rp)>) == sizeof(void*) + sizeof(std::unique_ptr<std::string>));
+
+    {
+        auto item = rp.acquire();
+        EXPECT_TRUE(item);
+        EXPECT_EQ(0, rp.size());
+        EXPECT_EQ(__TIME__, *item.get());
+        EXPECT_EQ(std::string(__TIME__).size(), item->size());
+    }
+    // Returned on scope exit
+    EXPECT_EQ(1, rp.size());
+
+    // ..and during stack unwinding
+    try {
+        auto item = rp.acquire();
+        item->append("-ok");
+        throw std::runtime_error("failure while holding the lease");
+    }
+    catch (const std::runtime_error&) {
+    }
+    EXPECT_EQ(1, rp.size());
+
+    // Moving transfers the responsibility
+    auto                            a = rp.acquire();
+    siddiqsoft::lease<decltype(rp)> b {std::move(a)};
+    EXPECT_FALSE(a);
+    EXPECT_TRUE(b);
+    EXPECT_TRUE(b->ends_with("-ok"));
+    b.reset();
+    EXPECT_FALSE(b);
+    EXPECT_EQ(1, rp.size());
+
+    // A released element is not returned
+    {
+        auto item   = rp.acquire();
+        auto broken = item.release();
+        EXPECT_FALSE(item);
+    }
+    EXPECT_EQ(0, rp.size());
+}
+
+
+TEST(resource_pool, T_lease_vector_string)
+{
+    siddiqsoft::resource_pool<std::vector<std::string>> rp {};
+    rp.checkin({"A", "B", "C"});
+
+    {
+        auto item = rp.acquire();
+        item->push_back("D");
+        EXPECT_EQ(4, (*item).size());
+    }
+    EXPECT_EQ(4, rp.checkout().size());
+}
+
+
+TEST(resource_pool, T_try_checkout)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {};
+
+    EXPECT_FALSE(rp.try_checkout());
+    EXPECT_FALSE(rp.checkout_for(std::chrono::milliseconds(5)));
+
+    rp.checkin(std::make_unique<int>(7));
+    auto item = rp.try_checkout();
+    ASSERT_TRUE(item);
+    EXPECT_EQ(7, **item);
+    EXPECT_EQ(0, rp.size());
+}
+
+
+TEST(resource_pool, T_checkout_for_fifo)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {};
+    std::mutex                                      orderLock {};
+    std::vector<int>                                order {};
+    std::atomic_int                                 parked {0};
+
+    // Three callers park in turn..
+    std::vector<std::jthread> callers {};
+    for (int i = 0; i < 3; i++) {
+        callers.emplace_back([&, i]() {
+            parked++;
+            auto item = rp.checkout_for(std::chrono::seconds(5));
+            ASSERT_TRUE(item);
+            std::lock_guard<std::mutex> l(orderLock);
+            order.push_back(i * 10 + **item);
+        });
+        while (parked.load() <= i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    // ..and are served in arrival order by the checkins
+    for (int i = 0; i < 3; i++) {
+        rp.checkin(std::make_unique<int>(i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    callers.clear();
+
+    EXPECT_EQ((std::vector<int> {0, 11, 22}), order);
+    EXPECT_EQ(0, rp.size());
+}
+
+
+TEST(resource_pool, T_factory)
+{
+    std::atomic_int                                 created {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory  = [&]() { return std::make_unique<int>(created++); },
+                                                         .minIdle  = 4,
+                                                         .maxTotal = 6}};
+
+    EXPECT_EQ(0, rp.size());
+    EXPECT_EQ(4, rp.prewarm());
+    EXPECT_EQ(4, rp.size());
+    EXPECT_EQ(4, rp.total());
+    // Already at minIdle
+    EXPECT_EQ(0, rp.prewarm());
+
+    // The pool creates on demand once the idle elements are used up..
+    std::vector<std::unique_ptr<int>> held {};
+    for (int i = 0; i < 6; i++) {
+        held.push_back(rp.checkout());
+    }
+    EXPECT_EQ(6, created.load());
+    // ..up to maxTotal
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+    EXPECT_FALSE(rp.checkout_for(std::chrono::milliseconds(5)));
+
+    // Discarding makes room for a replacement
+    rp.discard(std::move(held.back()));
+    held.pop_back();
+    EXPECT_EQ(5, rp.total());
+    EXPECT_EQ(6, *rp.checkout());
+}
+
+
+TEST(resource_pool, T_lease_discard)
+{
+    std::atomic_int                                 created {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory       = [&]() { return std::make_unique<int>(created++); },
+                                                         .maxTotal      = 1,
+                                                         .trackHeldTime = true}};
+
+    // A broken element dropped through the lease frees its slot..
+    for (int i = 0; i < 3; i++) {
+        auto item = rp.acquire();
+        EXPECT_EQ(i, **item);
+        item.discard();
+        EXPECT_FALSE(item);
+        EXPECT_EQ(0, rp.total());
+    }
+    EXPECT_EQ(3, created.load());
+    EXPECT_EQ(0, rp.stats().outstanding);
+
+    // ..while a released one keeps it until handed to discard()
+    auto item     = rp.acquire();
+    auto released = item.release();
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+    rp.discard(std::move(released));
+    EXPECT_EQ(4, *rp.checkout());
+}
+
+
+TEST(resource_pool, T_factory_single_flight)
+{
+    std::atomic_int                                 inFlight {0}, maxInFlight {0}, created {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory = [&]() {
+        auto now = ++inFlight;
+        maxInFlight = std::max(maxInFlight.load(), now);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --inFlight;
+        return std::make_unique<int>(created++);
+    }}};
+
+    // A burst of checkouts against an empty pool
+    std::atomic_int           served {0};
+    std::vector<std::jthread> callers {};
+    for (int i = 0; i < 8; i++) {
+        callers.emplace_back([&]() {
+            if (auto item = rp.checkout_for(std::chrono::seconds(5)); item) served++;
+        });
+    }
+    callers.clear();
+
+    EXPECT_EQ(8, served.load());
+    EXPECT_EQ(8, created.load());
+    // The backend never saw concurrent creation
+    EXPECT_EQ(1, maxInFlight.load());
+}
+
+
+TEST(resource_pool, T_prewarm_parallel)
+{
+    siddiqsoft::resource_pool<std::shared_ptr<int>> rp {{.factory = []() {
+                                                             std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                                                             return std::make_shared<int>(1);
+                                                         },
+                                                         .maxTotal = 20}};
+
+    // Limited by maxTotal
+    EXPECT_EQ(20, rp.prewarm(32));
+    EXPECT_EQ(20, rp.size());
+    EXPECT_EQ(20, rp.total());
+    // Prewarmed elements are not checkins
+    EXPECT_EQ(0, rp.stats().checkins);
+}
+
+
+TEST(resource_pool, T_evict_idle)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.minIdle = 2, .maxIdle = std::chrono::milliseconds(20)}};
+    for (int i = 0; i < 5; i++) {
+        rp.checkin(std::make_unique<int>(i));
+    }
+
+    EXPECT_EQ(0, rp.evict());
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    // The least recently used are evicted down to minIdle
+    EXPECT_EQ(3, rp.evict());
+    EXPECT_EQ(2, rp.size());
+    EXPECT_EQ(3, *rp.checkout());
+    EXPECT_EQ(3, rp.stats().evictedIdle);
+}
+
+
+TEST(resource_pool, T_max_lifetime)
+{
+    std::atomic_int                                 created {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory     = [&]() { return std::make_unique<int>(created++); },
+                                                         .maxLifetime = std::chrono::milliseconds(30)}};
+
+    // The lifetime spans the checkouts; the element is destroyed instead of pooled on checkin
+    auto item = rp.checkout();
+    rp.checkin(std::move(item));
+    EXPECT_EQ(1, rp.size());
+    item = rp.checkout();
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    rp.checkin(std::move(item));
+    EXPECT_EQ(0, rp.size());
+    EXPECT_EQ(0, rp.total());
+
+    // An idle element past its lifetime is skipped by checkout
+    EXPECT_EQ(1, rp.prewarm(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_EQ(2, *rp.checkout());
+    EXPECT_EQ(3, created.load());
+    EXPECT_EQ(2, rp.stats().evictedExpired);
+}
+
+
+TEST(resource_pool, T_reaper)
+{
+    siddiqsoft::resource_pool<std::shared_ptr<int>> rp {{.factory      = []() { return std::make_shared<int>(0); },
+                                                         .minIdle      = 1,
+                                                         .maxIdle      = std::chrono::milliseconds(20),
+                                                         .reapInterval = std::chrono::milliseconds(10)}};
+
+    // The reaper tops up to minIdle..
+    for (int i = 0; i < 50 && rp.size() < 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1, rp.size());
+
+    // ..and trims the spike back down once it has been idle
+    std::vector<std::shared_ptr<int>> spike {};
+    for (int i = 0; i < 6; i++) {
+        spike.push_back(rp.checkout());
+    }
+    for (auto& item : spike) {
+        rp.checkin(std::move(item));
+    }
+    EXPECT_LE(6, rp.size());
+    for (int i = 0; i < 50 && rp.size() > 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1, rp.size());
+    EXPECT_LE(5, rp.stats().evictedIdle);
+}
+
+
+TEST(resource_pool, T_validate_on_checkout)
+{
+    std::atomic_int                                 validations {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory           = []() { return std::make_unique<int>(100); },
+                                                         .validator         = [&](std::unique_ptr<int>& item) {
+                                                             validations++;
+                                                             return *item >= 0;
+                                                         },
+                                                         .validateAfterIdle = std::chrono::milliseconds(20)}};
+
+    // Recently used elements are handed out without validation
+    rp.checkin(std::make_unique<int>(1));
+    auto item = rp.checkout();
+    EXPECT_EQ(0, validations.load());
+    rp.checkin(std::move(item));
+
+    // ..idle ones are validated
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(1, *rp.checkout());
+    EXPECT_EQ(1, validations.load());
+
+    // A rejected element is destroyed and the next one (here a new one) is handed out
+    rp.checkin(std::make_unique<int>(-1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(100, *rp.checkout());
+    EXPECT_EQ(2, validations.load());
+    EXPECT_EQ(1, rp.stats().failedValidation);
+}
+
+
+TEST(resource_pool, T_revalidate)
+{
+    std::atomic_int                                 validations {0};
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.validator         = [&](std::unique_ptr<int>& item) {
+                                                             validations++;
+                                                             if (*item == 13) throw std::runtime_error("connection reset");
+                                                             return *item >= 0;
+                                                         },
+                                                         .validateAfterIdle = std::chrono::milliseconds(20)}};
+    for (int i : {1, -1, 2, 13}) {
+        rp.checkin(std::make_unique<int>(i));
+    }
+    // Nothing is due yet
+    EXPECT_EQ(0, rp.revalidate());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(2, rp.revalidate());
+    EXPECT_EQ(4, validations.load());
+    EXPECT_EQ(2, rp.size());
+
+    // The sweep spares the checkouts from validating
+    EXPECT_EQ(1, *rp.checkout());
+    EXPECT_EQ(2, *rp.checkout());
+    EXPECT_EQ(4, validations.load());
+}
+
+
+TEST(resource_pool, T_stats)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.factory       = []() { return std::make_unique<int>(7); },
+                                                         .maxTotal      = 2,
+                                                         .trackHeldTime = true}};
+    EXPECT_EQ(0, rp.size());
+
+    // Both checkouts find the pool empty and create
+    auto a = rp.checkout();
+    auto b = rp.checkout();
+    EXPECT_FALSE(rp.try_checkout());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    rp.checkin(std::move(a));
+    EXPECT_EQ(1, rp.size());
+
+    auto c = rp.checkout();
+    rp.checkin(std::move(b));
+    rp.checkin(std::move(c));
+
+    auto s = rp.stats();
+    EXPECT_EQ(3, s.checkouts);
+    EXPECT_EQ(3, s.checkins);
+    EXPECT_EQ(3, s.emptyEvents);
+    EXPECT_EQ(0, s.outstanding);
+    EXPECT_EQ(2, s.peakOutstanding);
+    EXPECT_EQ(3, s.waitTime.count());
+    EXPECT_EQ(3, s.heldTime.count());
+    EXPECT_LE(std::chrono::milliseconds(5), s.heldTime.percentile(100));
+    EXPECT_LT(0.0, s.checkoutRate);
+    EXPECT_EQ(2, rp.size());
+
+    // The rate covers the window since the previous snapshot
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(0.0, rp.stats().checkoutRate);
+
+    rp.reset_peak();
+    EXPECT_EQ(0, rp.stats().peakOutstanding);
+
+    // Adding a new element is not a return
+    auto d = rp.checkout();
+    rp.checkin(std::make_unique<int>(8));
+    EXPECT_EQ(1, rp.stats().outstanding);
+    rp.checkin(std::move(d));
+    EXPECT_EQ(0, rp.stats().outstanding);
+
+    auto info = rp.toJson();
+    EXPECT_EQ(4, info["stats"]["checkouts"].get<int>());
+    EXPECT_TRUE(info["stats"].contains("waitTimeUs"));
+}
+
+
+TEST(resource_pool, T_lifo)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {{.reuse = siddiqsoft::reuse_order::lifo}};
+    for (int i = 0; i < 4; i++) {
+        rp.checkin(std::make_unique<int>(i));
+    }
+
+    // The most recently returned element is handed out first..
+    EXPECT_EQ(3, *rp.checkout());
+    auto item = rp.checkout();
+    EXPECT_EQ(2, *item);
+    rp.checkin(std::move(item));
+    EXPECT_EQ(2, *rp.checkout());
+    // ..while the least recently used one remains at the front for the idle eviction
+    EXPECT_EQ(1, *rp.checkout());
+    EXPECT_EQ(0, *rp.checkout());
+}
+
+
+TEST(resource_pool, T_lifo_cache_warm)
+{
+    // Large per-element buffers: FIFO rotates through all of them (cold in cache) while LIFO keeps reusing the same one
+    constexpr size_t BufferSize = 256 * 1024;
+    constexpr int    Buffers    = 64;
+    constexpr int    Rounds     = 2000;
+
+    auto run = [&](siddiqsoft::reuse_order order, std::set<const char*>& touched) {
+        siddiqsoft::resource_pool<std::unique_ptr<std::vector<char>>> rp {{.reuse = order}};
+        for (int i = 0; i < Buffers; i++) {
+            rp.checkin(std::make_unique<std::vector<char>>(BufferSize, char(i)));
+        }
+
+        uint64_t   sum {0};
+        const auto started = std::chrono::steady_clock::now();
+        for (int r = 0; r < Rounds; r++) {
+            auto buffer = rp.checkout();
+            touched.insert(buffer->data());
+            for (size_t i = 0; i < buffer->size(); i += 64) {
+                sum += static_cast<unsigned char>((*buffer)[i]++);
+            }
+            rp.checkin(std::move(buffer));
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        EXPECT_LT(0u, sum);
+        return elapsed;
+    };
+
+    std::set<const char*> fifoTouched {}, lifoTouched {};
+    const auto            fifo = run(siddiqsoft::reuse_order::fifo, fifoTouched);
+    const auto            lifo = run(siddiqsoft::reuse_order::lifo, lifoTouched);
+    std::cerr << "fifo: " << fifo.count() << "us (" << fifoTouched.size() << " buffers)  lifo: " << lifo.count() << "us ("
+              << lifoTouched.size() << " buffers)" << std::endl;
+
+    EXPECT_EQ(Buffers, fifoTouched.size());
+    EXPECT_EQ(1, lifoTouched.size());
+}
+
+
+TEST(resource_pool, T_shared_ledger)
+{
+    // Two pools sharing a ledger (as the shards of a sharded_resource_pool do): an element created or checked out by one pool
+    // may be checked into, evicted or discarded by the other
+    siddiqsoft::resource_pool_ledger                        ledger {};
+    siddiqsoft::resource_pool_options<std::unique_ptr<int>> options {.factory     = []() { return std::make_unique<int>(1); },
+                                                                     .maxTotal    = 1,
+                                                                     .maxLifetime = std::chrono::milliseconds(20)};
+    siddiqsoft::resource_pool<std::unique_ptr<int>>         a {options, ledger}, b {options, ledger};
+
+    auto item = a.checkout();
+    EXPECT_EQ(1, ledger.total.load());
+    EXPECT_EQ(1, b.stats().outstanding);
+    // The limit spans both pools
+    EXPECT_THROW(auto x = b.checkout(), std::runtime_error);
+
+    // The return is accounted for by the receiving pool
+    b.checkin(std::move(item));
+    EXPECT_EQ(0, a.stats().outstanding);
+    EXPECT_TRUE(ledger.checkedOut.empty());
+
+    // ..and the lifetime follows the element: it expires on its return to the first pool
+    item = b.checkout();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    a.checkin(std::move(item));
+    EXPECT_EQ(1, a.stats().evictedExpired);
+    EXPECT_EQ(0, ledger.total.load());
+    EXPECT_EQ(0, ledger.outstanding.load());
+
+    item = a.checkout();
+    b.discard(std::move(item));
+    EXPECT_EQ(0, a.total());
+    EXPECT_EQ(0, b.stats().outstanding);
+    EXPECT_TRUE(ledger.checkedOut.empty());
+    EXPECT_TRUE(a.checkout());
+}
+
+
+TEST(resource_pool, T_checkout_for_durations)
+{
+    siddiqsoft::resource_pool<std::unique_ptr<int>> rp {};
+
+    // Floating-point durations
+    EXPECT_FALSE(rp.checkout_for(std::chrono::duration<double, std::milli>(2.5)));
+
+    // duration::max() waits for the checkin instead of overflowing into an expired deadline
+    std::jthread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        rp.checkin(std::make_unique<int>(5));
+    });
+    auto item = rp.checkout_for(std::chrono::nanoseconds::max());
+    ASSERT_TRUE(item);
+    EXPECT_EQ(5, **item);
+}
@@ -40,6 +40,10 @@
 #include <string>
 #include <barrier>
 #include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <algorithm>
 
 #include "nlohmann/json.hpp"
 #include "../include/siddiqsoft/roundrobin_pool.hpp"
@@ -96,3 +100,361 @@ TEST(roundrobin_pool, test2)
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     EXPECT_EQ(passTest.load(), FEEDER_COUNT * WORKER_POOLSIZE);
 }
+
+
+TEST(roundrobin_pool, stats)
+{
+    siddiqsoft::roundrobin_pool<uint32_t, 4> workers {[](auto&&) {}};
+
+    for (uint32_t i = 0; i < 40; i++) {
+        workers.queue(std::move(i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto s = workers.stats();
+    EXPECT_EQ(4, s.size());
+    for (const auto& w : s) {
+        EXPECT_EQ(10, w.queued);
+        EXPECT_EQ(10, w.processed);
+        EXPECT_EQ(0, w.depth);
+    }
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(roundrobin_pool, skew)
+{
+    std::atomic_bool                         release {false};
+    std::atomic_uint                         passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4> workers {[&](auto&& item) {
+        // Item zero holds up its worker (and the items queued behind it)
+        if (item == 0) {
+            while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        passTest++;
+    }};
+    EXPECT_EQ(1.0, workers.imbalance());
+
+    for (uint32_t i = 0; i < 40; i++) {
+        workers.queue(std::move(i));
+    }
+    for (int i = 0; i < 100 && passTest.load() < 30; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // The entire backlog sits on a single worker
+    EXPECT_EQ(4.0, workers.imbalance());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release = true;
+    for (int i = 0; i < 100 && passTest.load() < 40; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(40, passTest.load());
+    EXPECT_EQ(1.0, workers.imbalance());
+
+    auto st = workers.service_times();
+    EXPECT_EQ(40, st.count());
+    EXPECT_GE(st.percentile(100), std::chrono::milliseconds(20));
+    EXPECT_LT(st.percentile(50), std::chrono::milliseconds(20));
+
+    // The hot worker reports the busy time
+    auto s = workers.stats();
+    EXPECT_GE(std::ranges::max(s, {}, &siddiqsoft::queue_stats::busyTime).busyTime, std::chrono::milliseconds(20));
+
+    auto info = workers.toJson();
+    std::cerr << info.dump() << std::endl;
+    EXPECT_EQ(40, info["serviceTimeUs"].value("count", 0));
+}
+
+
+TEST(roundrobin_pool, resize)
+{
+    std::atomic_uint                         passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4> workers {[&](auto&&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        passTest++;
+    }};
+    EXPECT_EQ(4, workers.stats().size());
+
+    for (uint32_t i = 0; i < 200; i++) {
+        workers.queue(std::move(i));
+    }
+
+    // Retire three workers; their backlog moves to the survivor
+    workers.resize(1);
+    EXPECT_EQ(1, workers.stats().size());
+    // ..and grow again; there is no upper bound other than the resources available
+    workers.resize(40);
+    EXPECT_EQ(40, workers.stats().size());
+    for (uint32_t i = 0; i < 80; i++) {
+        workers.queue(std::move(i));
+    }
+    workers.resize(8);
+    EXPECT_EQ(8, workers.stats().size());
+    EXPECT_THROW(workers.resize(0), std::out_of_range);
+
+    for (int i = 0; i < 100 && passTest.load() < 280; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_EQ(280, passTest.load());
+    // The retired workers' service times are retained
+    EXPECT_EQ(280, workers.service_times().count());
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(roundrobin_pool, power_of_two)
+{
+    std::atomic_bool                         release {false};
+    std::atomic_uint                         passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4, siddiqsoft::power_of_two_dispatch> workers {[&](auto&& item) {
+        // One outlier parks its worker
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        passTest++;
+    }};
+
+    workers.queue(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (uint32_t i = 1; i <= 400; i++) {
+        workers.queue(std::move(i));
+        // Steady arrival rate so the healthy workers keep up
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // With plain round robin a quarter of the items would be stuck behind the outlier. Two choices only picks the parked worker
+    // when both samples are heavily loaded.
+    EXPECT_GE(passTest.load(), 390);
+    size_t parked {0};
+    for (const auto& s : workers.stats()) {
+        parked = std::max<size_t>(parked, s.depth);
+    }
+    EXPECT_LE(parked, 10);
+
+    release = true;
+    for (int i = 0; i < 100 && passTest.load() < 401; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(401, passTest.load());
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(roundrobin_pool, key_affinity)
+{
+    struct keyed_item
+    {
+        uint32_t account {0};
+        uint32_t sequence {0};
+    };
+
+    std::mutex                                    results_mutex {};
+    std::map<uint32_t, std::vector<uint32_t>>     sequences {};
+    std::map<uint32_t, std::set<std::thread::id>> threads {};
+    std::atomic_uint                              passTest {0};
+
+    siddiqsoft::roundrobin_pool<keyed_item, 4> workers {[&](auto&& item) {
+        std::lock_guard<std::mutex> l(results_mutex);
+        sequences[item.account].push_back(item.sequence);
+        threads[item.account].insert(std::this_thread::get_id());
+        passTest++;
+    }};
+
+    for (uint32_t s = 0; s < 50; s++) {
+        for (uint32_t account = 0; account < 16; account++) {
+            workers.queue(account, keyed_item {account, s});
+        }
+    }
+
+    for (int i = 0; i < 100 && passTest.load() < 800; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(800, passTest.load());
+
+    std::lock_guard<std::mutex> l(results_mutex);
+    std::set<std::thread::id>   allThreads {};
+    for (uint32_t account = 0; account < 16; account++) {
+        // Every account is processed by a single worker in the order queued
+        EXPECT_EQ(1, threads[account].size());
+        EXPECT_TRUE(std::is_sorted(sequences[account].begin(), sequences[account].end()));
+        EXPECT_EQ(50, sequences[account].size());
+        allThreads.insert(threads[account].begin(), threads[account].end());
+    }
+    // ..while the accounts are spread across the workers
+    EXPECT_GT(allThreads.size(), 1);
+}
+
+
+TEST(roundrobin_pool, key_affinity_resize)
+{
+    struct keyed_item
+    {
+        uint32_t account {0};
+        uint32_t sequence {0};
+    };
+
+    std::mutex                                results_mutex {};
+    std::map<uint32_t, std::vector<uint32_t>> sequences {};
+    std::atomic_uint                          passTest {0};
+
+    siddiqsoft::roundrobin_pool<keyed_item, 2> workers {[&](auto&& item) {
+        {
+            std::lock_guard<std::mutex> l(results_mutex);
+            sequences[item.account].push_back(item.sequence);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        passTest++;
+    }};
+
+    // Grow, shrink below the original size and grow again while every account has a backlog
+    uint32_t s = 0;
+    for (size_t size : {6, 1, 3}) {
+        for (const auto end = s + 20; s < end; s++) {
+            for (uint32_t account = 0; account < 16; account++) {
+                workers.queue(account, keyed_item {account, s});
+            }
+        }
+        workers.resize(size);
+    }
+    for (const auto end = s + 20; s < end; s++) {
+        for (uint32_t account = 0; account < 16; account++) {
+            workers.queue(account, keyed_item {account, s});
+        }
+    }
+
+    for (int i = 0; i < 200 && passTest.load() < 1280; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1280, passTest.load());
+
+    std::lock_guard<std::mutex> l(results_mutex);
+    for (uint32_t account = 0; account < 16; account++) {
+        // The remapped accounts took their backlog along
+        EXPECT_TRUE(std::is_sorted(sequences[account].begin(), sequences[account].end())) << "account " << account;
+        EXPECT_EQ(80, sequences[account].size());
+    }
+}
+
+
+/// @brief User-defined policy: always the last worker
+struct last_worker_dispatch
+{
+    template <typename LoadFn>
+    size_t select(uint64_t, size_t n, LoadFn&&) const noexcept
+    {
+        return n - 1;
+    }
+};
+
+
+template <typename P>
+void exercise_dispatch_policy(size_t expectedBusyWorkers)
+{
+    std::atomic_uint                            passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4, P> workers {[&](auto&&) { passTest++; }};
+
+    for (uint32_t i = 0; i < 100; i++) {
+        workers.queue(std::move(i));
+    }
+    for (int i = 0; i < 100 && passTest.load() < 100; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(100, passTest.load());
+
+    size_t busy {0};
+    for (const auto& s : workers.stats()) {
+        if (s.queued > 0) busy++;
+    }
+    if (expectedBusyWorkers > 0) {
+        EXPECT_EQ(expectedBusyWorkers, busy);
+    }
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(roundrobin_pool, dispatch_policies)
+{
+    static_assert(siddiqsoft::dispatch_policy<last_worker_dispatch>);
+
+    exercise_dispatch_policy<siddiqsoft::roundrobin_dispatch>(4);
+    exercise_dispatch_policy<siddiqsoft::random_dispatch>(0);
+    exercise_dispatch_policy<siddiqsoft::least_loaded_dispatch>(0);
+    exercise_dispatch_policy<siddiqsoft::power_of_two_dispatch>(0);
+    // A single producer's cursor rotates across all of the workers
+    exercise_dispatch_policy<siddiqsoft::thread_cursor_dispatch>(4);
+    // A single producer thread sticks to one worker
+    exercise_dispatch_policy<siddiqsoft::sticky_dispatch>(1);
+    exercise_dispatch_policy<last_worker_dispatch>(1);
+}
+
+
+TEST(roundrobin_pool, rebalancer)
+{
+    std::atomic_bool                          release {false};
+    std::atomic_uint                          passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4> workers {[&](auto&& item) {
+        // Item zero parks its worker until the end of the test
+        if (item == 0) {
+            while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        passTest++;
+    }};
+    workers.enable_rebalancer(std::chrono::milliseconds(5), std::chrono::milliseconds(20));
+
+    // The round robin dispatch places every fourth item behind the parked worker
+    for (uint32_t i = 0; i < 100; i++) {
+        workers.queue(std::move(i));
+    }
+    for (int i = 0; i < 200 && passTest.load() < 99; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Everything except the parked item was completed by the siblings
+    EXPECT_EQ(99, passTest.load());
+    EXPECT_EQ(1, workers.stalled_workers().size());
+
+    auto info = workers.toJson();
+    std::cerr << info.dump() << std::endl;
+    EXPECT_TRUE(info.value("rebalancer", false));
+    EXPECT_LE(24, info.value("stolenCounter", 0));
+
+    release = true;
+    for (int i = 0; i < 100 && passTest.load() < 100; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(100, passTest.load());
+    EXPECT_TRUE(workers.stalled_workers().empty());
+}
+
+
+TEST(roundrobin_pool, concurrent_producers)
+{
+    static_assert(siddiqsoft::dispatch_uses_sequence<siddiqsoft::roundrobin_dispatch>);
+    static_assert(!siddiqsoft::dispatch_uses_sequence<siddiqsoft::thread_cursor_dispatch>);
+    static_assert(siddiqsoft::dispatch_uses_sequence<last_worker_dispatch>);
+
+    std::atomic_uint                                                                passTest {0};
+    siddiqsoft::roundrobin_pool<uint32_t, 4, siddiqsoft::thread_cursor_dispatch> workers {[&](auto&&) { passTest++; }};
+
+    std::vector<std::jthread> producers {};
+    for (int p = 0; p < 8; p++) {
+        producers.emplace_back([&]() {
+            for (uint32_t i = 0; i < 1000; i++) {
+                workers.queue(std::move(i));
+            }
+        });
+    }
+    producers.clear();
+
+    for (int i = 0; i < 200 && passTest.load() < 8000; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(8000, passTest.load());
+
+    // The striped counter adds up to the total and every producer spread its items across all of the workers
+    auto info = workers.toJson();
+    EXPECT_EQ(8000, info.value("queueCounter", 0));
+    EXPECT_EQ("thread_cursor", info.value("dispatchPolicy", ""));
+    for (const auto& s : workers.stats()) {
+        EXPECT_EQ(2000, s.queued);
+    }
+}
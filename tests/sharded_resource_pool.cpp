@@ -0,0 +1,223 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <iostream>
+#include <format>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/sharded_resource_pool.hpp"
+
+
+TEST(sharded_resource_pool, T_unique_ptr_string)
+{
+    siddiqsoft::sharded_resource_pool<std::unique_ptr<std::string>> rp {4};
+    EXPECT_EQ(4, rp.shard_count());
+    EXPECT_GT(4u, rp.current_shard());
+
+    EXPECT_EQ(0, rp.size());
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+    EXPECT_FALSE(rp.try_checkout());
+
+    rp.checkin(std::make_unique<std::string>(__TIME__));
+    EXPECT_EQ(1, rp.size());
+
+    auto item = rp.checkout();
+    EXPECT_EQ(0, rp.size());
+    EXPECT_EQ(__TIME__, *item);
+    rp.checkin(std::move(item));
+    EXPECT_EQ(1, rp.size());
+}
+
+
+TEST(sharded_resource_pool, T_neighbour_fallback)
+{
+    constexpr size_t Shards = 8;
+    siddiqsoft::sharded_resource_pool<std::shared_ptr<int>> rp {Shards};
+
+    // Elements checked in from one thread are found by the threads running on the other cores
+    for (int i = 0; i < 10; i++) {
+        rp.checkin(std::make_shared<int>(i));
+    }
+    std::atomic_int total {0};
+    {
+        std::vector<std::jthread> threads {};
+        for (int t = 0; t < 5; t++) {
+            threads.emplace_back([&]() {
+                auto a = rp.checkout();
+                auto b = rp.checkout();
+                total += *a + *b;
+            });
+        }
+    }
+    EXPECT_EQ(45, total.load());
+    EXPECT_EQ(0, rp.size());
+    EXPECT_FALSE(rp.try_checkout());
+}
+
+
+TEST(sharded_resource_pool, T_factory_and_stats)
+{
+    std::atomic_int                                        created {0};
+    siddiqsoft::sharded_resource_pool<std::unique_ptr<int>> rp {{.factory = [&]() { return std::make_unique<int>(created++); },
+                                                                 .maxTotal = 5},
+                                                                4};
+    EXPECT_EQ(4, rp.prewarm(4));
+    EXPECT_EQ(4, rp.size());
+
+    // The idle elements of every shard are used before creating more
+    std::vector<std::unique_ptr<int>> items {};
+    for (int i = 0; i < 4; i++) {
+        items.push_back(rp.checkout());
+    }
+    EXPECT_EQ(4, created.load());
+    // maxTotal bounds the whole pool: room for one more
+    items.push_back(rp.checkout());
+    EXPECT_EQ(5, created.load());
+    EXPECT_EQ(5, rp.total());
+    EXPECT_THROW(auto x = rp.checkout(), std::runtime_error);
+
+    for (auto& item : items) rp.checkin(std::move(item));
+    EXPECT_EQ(5, rp.size());
+
+    auto s = rp.stats();
+    EXPECT_EQ(5, s.checkouts);
+    EXPECT_EQ(5, s.checkins);
+    EXPECT_EQ(5, s.idle);
+    EXPECT_EQ(5, s.total);
+    EXPECT_EQ(4, rp.toJson()["shards"].get<int>());
+}
+
+
+TEST(sharded_resource_pool, T_migrated_element_released)
+{
+#if defined(__linux__)
+    // Two CPUs the test may run on
+    cpu_set_t allowed {};
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+    std::vector<int> cpus {};
+    for (int c = 0; (c < CPU_SETSIZE) && (cpus.size() < 2); c++) {
+        if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+    }
+    if (cpus.size() < 2) GTEST_SKIP() << "needs two CPUs";
+
+    // Runs the callback on a thread pinned to the cpu
+    auto on = [](int cpu, auto&& callback) {
+        std::jthread([&]() {
+            cpu_set_t one {};
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+            callback();
+        }).join();
+    };
+
+    siddiqsoft::sharded_resource_pool<std::unique_ptr<int>> rp {
+            {.factory = []() { return std::make_unique<int>(1); }, .maxTotal = 1, .maxLifetime = std::chrono::milliseconds(5)},
+            size_t(cpus[1]) + 1};
+
+    for (int i = 0; i < 5; i++) {
+        // Created by the shard of the first cpu and checked into the shard of the second one..
+        std::unique_ptr<int> item {};
+        size_t               created {0}, returned {0};
+        on(cpus[0], [&]() {
+            created = rp.current_shard();
+            item    = rp.checkout();
+        });
+        on(cpus[1], [&]() {
+            returned = rp.current_shard();
+            if (i % 2 == 0)
+                rp.checkin(std::move(item));
+            else
+                rp.discard(std::move(item));
+        });
+        EXPECT_NE(created, returned);
+
+        // ..where it expires (or was discarded); the creating shard gets its room back
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        on(cpus[1], [&]() { EXPECT_FALSE(rp.try_checkout()); });
+        EXPECT_EQ(0, rp.total());
+        EXPECT_EQ(0, rp.stats().outstanding);
+    }
+#else
+    GTEST_SKIP() << "needs sched_getaffinity";
+#endif
+}
+
+
+TEST(sharded_resource_pool, T_checkout_for_across_shards)
+{
+    siddiqsoft::sharded_resource_pool<std::unique_ptr<int>> rp {4};
+    EXPECT_FALSE(rp.checkout_for(std::chrono::milliseconds(5)));
+    EXPECT_FALSE(rp.checkout_for(std::chrono::duration<double, std::milli>(2.5)));
+
+    // The element may land in any shard; the waiter finds it
+    std::jthread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        rp.checkin(std::make_unique<int>(7));
+    });
+    auto item = rp.checkout_for(std::chrono::duration<double>::max());
+    ASSERT_TRUE(item);
+    EXPECT_EQ(7, **item);
+}
+
+
+TEST(sharded_resource_pool, T_concurrent)
+{
+    siddiqsoft::sharded_resource_pool<std::unique_ptr<int>> rp {};
+    for (int i = 0; i < 64; i++) {
+        rp.checkin(std::make_unique<int>(i));
+    }
+
+    {
+        std::vector<std::jthread> threads {};
+        for (unsigned t = 0; t < std::max(4u, std::thread::hardware_concurrency()); t++) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 20000; i++) {
+                    auto item = rp.try_checkout();
+                    if (item) rp.checkin(std::move(*item));
+                }
+            });
+        }
+    }
+    EXPECT_EQ(64, rp.size());
+}
@@ -175,3 +175,239 @@ TEST(simple_pool, test3)
     EXPECT_EQ(passTest.load(), std::thread::hardware_concurrency());
     std::cerr << nlohmann::json(workers).dump() << std::endl;
 }
+
+
+TEST(simple_pool, task_group_wait)
+{
+    std::atomic_uint                     passTest {0};
+    siddiqsoft::task_group               batch {};
+    siddiqsoft::simple_pool<uint32_t, 4> workers {[&passTest](auto&& item) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(item % 5));
+        if (item % 7 == 0) throw std::runtime_error("failures also complete the item");
+        passTest++;
+    }};
+
+    for (uint32_t i = 1; i <= 100; i++) {
+        workers.queue(batch, std::move(i));
+    }
+    // Items outside the group do not hold up the wait (this one throws so it is not counted)
+    workers.queue(700);
+
+    EXPECT_TRUE(batch.wait_for(std::chrono::seconds(10)));
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(100 - (100 / 7), passTest.load());
+
+    // The group may be reused once it is empty
+    workers.queue(batch, 1);
+    batch.wait();
+    EXPECT_EQ(0, batch.pending());
+}
+
+
+TEST(simple_pool, task_group_short_lived)
+{
+    // The waiter destroys the group as soon as it observes completion; the pool thread must be done with it by then
+    std::atomic_uint                     passTest {0};
+    siddiqsoft::simple_pool<uint32_t, 4> workers {[&passTest](auto&& item) { passTest += item; }};
+
+    for (uint32_t i = 0; i < 20000; i++) {
+        siddiqsoft::task_group batch {};
+        workers.queue(batch, 1);
+        if (i % 2 == 0)
+            batch.wait();
+        else
+            workers.wait(batch);
+    }
+    EXPECT_EQ(20000, passTest.load());
+}
+
+
+TEST(simple_pool, task_group_abandoned)
+{
+    siddiqsoft::task_group batch {};
+    {
+        siddiqsoft::simple_pool<uint32_t, 1> workers {[](auto&&) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }};
+        for (uint32_t i = 0; i < 10; i++) {
+            workers.queue(batch, std::move(i));
+        }
+        // Destroying the pool abandons the remaining items
+    }
+    EXPECT_TRUE(batch.empty());
+}
+
+
+TEST(simple_pool, run_pending)
+{
+    std::atomic_uint                     passTest {0};
+    std::atomic_bool                     release {false};
+    std::thread::id                      caller {std::this_thread::get_id()};
+    std::atomic_uint                     ranOnCaller {0};
+    siddiqsoft::simple_pool<uint32_t, 1> workers {[&](auto&& item) {
+        // The first item parks the only pool thread
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (std::this_thread::get_id() == caller) ranOnCaller++;
+        passTest++;
+    }};
+
+    workers.queue(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    siddiqsoft::task_group batch {};
+    for (uint32_t i = 1; i <= 10; i++) {
+        workers.queue(batch, std::move(i));
+    }
+
+    // Execute at most two items on this thread
+    EXPECT_EQ(2, workers.run_pending(2));
+    EXPECT_EQ(2, ranOnCaller.load());
+    // Deadline already passed; nothing is started
+    EXPECT_EQ(0, workers.run_pending(std::chrono::steady_clock::now() - std::chrono::seconds(1)));
+    // The pool thread is still blocked so the waiter must drain the rest
+    EXPECT_TRUE(workers.wait_for(batch, std::chrono::seconds(5)));
+    EXPECT_EQ(10, ranOnCaller.load());
+
+    release = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(11, passTest.load());
+}
+
+
+TEST(simple_pool, wait_wakes_on_queue)
+{
+    // The only pool thread is parked until an item queued *after* the waiter blocked releases it; the waiter must be woken
+    // by queue() to run that item itself
+    std::atomic_bool                     release {false};
+    std::thread::id                      caller {std::this_thread::get_id()};
+    std::atomic_uint                     ranOnCaller {0};
+    siddiqsoft::simple_pool<uint32_t, 1> workers {[&](auto&& item) {
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        else {
+            if (std::this_thread::get_id() == caller) ranOnCaller++;
+            release = true;
+        }
+    }};
+
+    for (uint32_t round = 0; round < 2; round++) {
+        siddiqsoft::task_group batch {};
+        release = false;
+        workers.queue(batch, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::jthread late {[&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            workers.queue(batch, 1);
+        }};
+
+        if (round == 0)
+            EXPECT_TRUE(workers.wait_for(batch, std::chrono::seconds(5)));
+        else
+            workers.wait(batch);
+        EXPECT_EQ(round + 1, ranOnCaller.load());
+    }
+}
+
+
+TEST(simple_pool, cancellation)
+{
+    std::atomic_uint                     passTest {0};
+    std::atomic_bool                     release {false};
+    siddiqsoft::simple_pool<uint32_t, 1> workers {[&](auto&& item) {
+        // The first item parks the only pool thread
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        passTest++;
+    }};
+
+    workers.queue(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::stop_source       client {};
+    siddiqsoft::task_group batch {};
+    for (uint32_t i = 1; i <= 10; i++) {
+        // Odd items belong to a client which goes away
+        if (i % 2)
+            workers.queue(batch, std::move(i), client.get_token());
+        else
+            workers.queue(std::move(i), std::stop_token {});
+    }
+    workers.queue(11, client.get_token());
+    workers.queue(12, client.get_token());
+
+    client.request_stop();
+    // Eagerly remove all of the cancelled items
+    EXPECT_EQ(7, workers.purge_cancelled());
+    EXPECT_EQ(0, workers.purge_cancelled());
+
+    release = true;
+    EXPECT_TRUE(workers.wait_for(batch, std::chrono::seconds(5)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(6, passTest.load());
+    EXPECT_EQ(7, workers.toJson().value("skippedCounter", 0));
+}
+
+
+TEST(simple_pool, stats)
+{
+    std::atomic_bool                     release {false};
+    siddiqsoft::simple_pool<uint32_t, 1> workers {[&](auto&& item) {
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (item % 2) throw std::runtime_error("odd items fail");
+    }};
+
+    workers.queue(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (uint32_t i = 1; i <= 10; i++) {
+        workers.queue(std::move(i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto s = workers.stats();
+    EXPECT_EQ(10, s.depth);
+    EXPECT_EQ(10, s.peakDepth);
+    EXPECT_EQ(11, s.queued);
+    EXPECT_EQ(0, s.processed);
+    EXPECT_GE(s.oldestItemAge.count(), 50000);
+
+    release = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    s = workers.stats();
+    EXPECT_EQ(0, s.depth);
+    EXPECT_EQ(10, s.peakDepth);
+    EXPECT_EQ(6, s.processed);
+    EXPECT_EQ(5, s.failed);
+    EXPECT_EQ(0, s.oldestItemAge.count());
+
+    workers.reset_peak();
+    EXPECT_EQ(0, workers.stats().peakDepth);
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(simple_pool, resize)
+{
+    std::atomic_uint                     passTest {0};
+    siddiqsoft::task_group               batch {};
+    siddiqsoft::simple_pool<uint32_t, 2> workers {[&](auto&&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        passTest++;
+    }};
+    EXPECT_EQ(2, workers.threadCount());
+
+    for (uint32_t i = 0; i < 200; i++) {
+        workers.queue(batch, std::move(i));
+    }
+
+    workers.resize(6);
+    EXPECT_EQ(6, workers.threadCount());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // Shrinking while items are in-flight must not drop any
+    workers.resize(1);
+    EXPECT_EQ(1, workers.threadCount());
+    EXPECT_THROW(workers.resize(0), std::invalid_argument);
+
+    EXPECT_TRUE(batch.wait_for(std::chrono::seconds(10)));
+    EXPECT_EQ(200, passTest.load());
+}
@@ -112,3 +112,38 @@ TEST(simple_worker, test3)
     std::this_thread::sleep_for(std::chrono::seconds(1));
     EXPECT_TRUE(passTest);
 }
+
+
+TEST(simple_worker, cancellation)
+{
+    std::atomic_uint                    passTest {0};
+    std::atomic_bool                    release {false};
+    siddiqsoft::simple_worker<uint32_t> worker {[&](auto&& item) {
+        if (item == 0)
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        passTest++;
+    }};
+
+    worker.queue(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::stop_source client {};
+    for (uint32_t i = 1; i <= 10; i++) {
+        if (i % 2)
+            worker.queue(std::move(i), client.get_token());
+        else
+            worker.queue(std::move(i));
+    }
+
+    client.request_stop();
+    // Remove some eagerly; anything cancelled after the purge is skipped at dequeue time
+    EXPECT_EQ(5, worker.purge_cancelled());
+    std::stop_source late {};
+    worker.queue(11, late.get_token());
+    late.request_stop();
+
+    release = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(6, passTest.load());
+    EXPECT_EQ(6, worker.toJson().value("skippedCounter", 0));
+}
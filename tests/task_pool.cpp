@@ -0,0 +1,130 @@
+/*
+    asynchrony-lib
+    Add asynchrony to your apps
+
+    BSD 3-Clause License
+
+    Copyright (c) 2021, Siddiq Software LLC
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <format>
+#include <string>
+#include <thread>
+#include <memory>
+#include <array>
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/task_pool.hpp"
+
+
+TEST(task, inline_and_heap_storage)
+{
+    int  counter {0};
+    auto small = [&counter]() { counter++; };
+
+    siddiqsoft::task t1 {small};
+    EXPECT_TRUE(t1);
+    EXPECT_TRUE(t1.is_inline());
+    t1();
+    EXPECT_EQ(1, counter);
+
+    // Capture larger than the inline capacity must spill to the heap but still work
+    std::array<char, 128> big {};
+    big[127] = 'x';
+    siddiqsoft::task t2 {[&counter, big]() { counter += (big[127] == 'x') ? 10 : 0; }};
+    EXPECT_TRUE(t2);
+    EXPECT_FALSE(t2.is_inline());
+    t2();
+    EXPECT_EQ(11, counter);
+
+    // Moving leaves the source empty
+    siddiqsoft::task t3 {std::move(t2)};
+    EXPECT_FALSE(t2);
+    t3();
+    EXPECT_EQ(21, counter);
+
+    siddiqsoft::task empty {};
+    EXPECT_FALSE(empty);
+    EXPECT_THROW(empty(), std::bad_function_call);
+}
+
+
+TEST(task, move_only_capture)
+{
+    auto             owned = std::make_unique<std::string>("move-only");
+    std::string      result {};
+    siddiqsoft::task t {[&result, p = std::move(owned)]() { result = *p; }};
+
+    EXPECT_TRUE(t.is_inline());
+    siddiqsoft::task moved {};
+    moved = std::move(t);
+    moved();
+    EXPECT_EQ("move-only", result);
+}
+
+
+TEST(task_pool, test1)
+{
+    std::atomic_uint           passTest {0};
+    siddiqsoft::task_pool<4>   workers {};
+    auto                       owned = std::make_unique<int>(41);
+
+    // Different callables (and captures) share the same pool
+    workers.queue([&passTest]() { passTest++; });
+    workers.queue([&passTest, p = std::move(owned)]() { passTest += (*p == 41) ? 1 : 0; });
+    for (unsigned i = 0; i < std::thread::hardware_concurrency(); i++) {
+        workers.queue([&passTest, s = std::format("item-{}", i)]() {
+            std::cerr << std::format("Item:{} .. {}\n", passTest.load(), s);
+            passTest++;
+        });
+    }
+
+    // This is important otherwise the destructor will kill the thread before it has a chance to process anything!
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(passTest.load(), 2 + std::thread::hardware_concurrency());
+    std::cerr << nlohmann::json(workers).dump() << std::endl;
+}
+
+
+TEST(task_pool, task_group)
+{
+    std::atomic_uint         passTest {0};
+    siddiqsoft::task_group   batch {};
+    siddiqsoft::task_pool<4> workers {};
+
+    for (unsigned i = 0; i < 64; i++) {
+        workers.queue(batch, [&passTest]() { passTest++; });
+    }
+
+    batch.wait();
+    EXPECT_EQ(64, passTest.load());
+}